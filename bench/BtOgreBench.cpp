@@ -0,0 +1,638 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreBench.cpp
+ *
+ *    Description:  Microbenchmarks of the mesh to shape converters. Runs headless, and
+ *                  writes the timings as JSON.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+//C++ standard library
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//Ogre includes
+#include <Ogre.h>
+#include <OgreDefaultHardwareBufferManager.h>
+#include <OgreMeshManager.h>
+#include <OgreMeshManager2.h>
+#include <OgreSubMesh.h>
+
+//BtOgre includes
+#include <BtOgre.hpp>
+
+using namespace Ogre;
+
+#ifndef BTOGRE_BENCH_DATA_DIR
+#define BTOGRE_BENCH_DATA_DIR "data/Meshes"
+#endif
+
+namespace
+{
+	///Command line options
+	struct Options
+	{
+		///Directory of the demo meshes
+		String dataDirectory{ BTOGRE_BENCH_DATA_DIR };
+
+		///Number of vertices on each side of the synthetic grids
+		size_t gridSize{ 256 };
+
+		///Number of timed runs of each benchmark
+		size_t iterations{ 10 };
+
+		///File to write the results to, stdout if empty
+		String output;
+
+		///Plugin of the NULL render system, needed by the v2 benchmarks
+		String nullRenderSystem{ "RenderSystem_NULL" };
+	};
+
+	void usage()
+	{
+		std::cerr << "Usage: BtOgre21_bench [options]\n"
+			<< "  -d <directory>   Directory of the demo meshes (default: " BTOGRE_BENCH_DATA_DIR ")\n"
+			<< "  -n <size>        Vertices on each side of the synthetic grid meshes (default: 256)\n"
+			<< "  -i <iterations>  Timed runs of each benchmark (default: 10)\n"
+			<< "  -o <file>        Write the JSON results to a file instead of stdout\n"
+			<< "  -r <plugin>      NULL render system plugin, for the v2 benchmarks (default: RenderSystem_NULL)\n";
+	}
+
+	///Escape a string to be written in a JSON document
+	String jsonString(const String& string)
+	{
+		String escaped{ "\"" };
+		for (const auto c : string)
+		{
+			if (c == '"' || c == '\\') escaped += '\\';
+			escaped += c;
+		}
+		return escaped + "\"";
+	}
+
+	///Shapes created by a benchmark, destroyed out of the timed section
+	using ShapeList = std::vector<btCollisionShape*>;
+
+	///Free a shape and what it owns
+	void destroyShape(btCollisionShape* shape)
+	{
+		if (shape->isCompound())
+		{
+			const auto compound = static_cast<btCompoundShape*>(shape);
+			for (auto i = compound->getNumChildShapes() - 1; i >= 0; --i)
+			{
+				const auto child = compound->getChildShape(i);
+				compound->removeChildShapeByIndex(i);
+				destroyShape(child);
+			}
+		}
+		else if (shape->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE)
+		{
+			delete static_cast<btTriangleMeshShape*>(shape)->getMeshInterface();
+		}
+		delete shape;
+	}
+
+	///Run the benchmarks and keep their timings
+	class Bench
+	{
+	public:
+		explicit Bench(size_t iterations) :
+			mIterations(iterations)
+		{
+		}
+
+		///Time a benchmark. The function is run once untimed to warm up, then mIterations times
+		void run(const String& name, size_t vertices, size_t triangles, const std::function<void(ShapeList&)>& function)
+		{
+			Result result{ name, vertices, triangles, {}, {} };
+			ShapeList shapes;
+			for (auto i = size_t{ 0U }; i <= mIterations; ++i)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				function(shapes);
+				const auto end = std::chrono::steady_clock::now();
+
+				if (i) result.timings.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+				for (auto shape : shapes)
+					destroyShape(shape);
+				shapes.clear();
+			}
+			mResults.push_back(result);
+			std::cerr << name << " : " << *std::min_element(result.timings.begin(), result.timings.end()) << " ms\n";
+		}
+
+		///Record a benchmark that can't run in this environment
+		void skip(const String& name, const String& reason)
+		{
+			mResults.push_back({ name, 0, 0, {}, reason });
+			std::cerr << name << " : skipped, " << reason << "\n";
+		}
+
+		///Record a sanity check of the converter output, the run fails if it doesn't hold
+		void check(const String& name, bool passed, const String& message)
+		{
+			if (passed) return;
+			mFailures.push_back(name + " : " + message);
+			std::cerr << name << " : check failed, " << message << "\n";
+		}
+
+		///True if every check held
+		bool passed() const
+		{
+			return mFailures.empty();
+		}
+
+		///Write the results as a JSON document
+		void writeJson(std::ostream& output, const Options& options) const
+		{
+			output << "{\n"
+				<< "  \"suite\": \"BtOgre21_bench\",\n"
+				<< "  \"iterations\": " << mIterations << ",\n"
+				<< "  \"grid_size\": " << options.gridSize << ",\n"
+				<< "  \"failures\": [";
+
+			for (auto i = size_t{ 0U }; i < mFailures.size(); ++i)
+				output << (i ? ", " : "") << jsonString(mFailures[i]);
+
+			output << "],\n"
+				<< "  \"results\": [";
+
+			for (auto i = size_t{ 0U }; i < mResults.size(); ++i)
+			{
+				const auto& result = mResults[i];
+				output << (i ? ",\n" : "\n") << "    { \"name\": " << jsonString(result.name);
+
+				if (!result.skipped.empty())
+				{
+					output << ", \"skipped\": " << jsonString(result.skipped) << " }";
+					continue;
+				}
+
+				auto sorted = result.timings;
+				std::sort(sorted.begin(), sorted.end());
+				const auto mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+
+				output << ", \"vertices\": " << result.vertices
+					<< ", \"triangles\": " << result.triangles
+					<< ", \"min_ms\": " << sorted.front()
+					<< ", \"median_ms\": " << sorted[sorted.size() / 2]
+					<< ", \"mean_ms\": " << mean
+					<< ", \"max_ms\": " << sorted.back() << " }";
+			}
+
+			output << "\n  ]\n}\n";
+		}
+
+	private:
+		///Timings of one benchmark, in milliseconds
+		struct Result
+		{
+			String name;
+			size_t vertices;
+			size_t triangles;
+			std::vector<double> timings;
+			String skipped;
+		};
+
+		size_t mIterations;
+		std::vector<Result> mResults;
+		std::vector<String> mFailures;
+	};
+
+	///Height of the synthetic grids, so the triangles aren't all coplanar
+	Real gridHeight(size_t x, size_t z)
+	{
+		return std::sin(Real(x) * 0.1f) * std::cos(Real(z) * 0.1f);
+	}
+
+	///Fill size x size positions of a grid, as 3 floats or 4 halves
+	void writeGridPositions(unsigned char* data, size_t size, VertexElementType type, size_t stride)
+	{
+		for (auto z = size_t{ 0U }; z < size; ++z)
+			for (auto x = size_t{ 0U }; x < size; ++x)
+			{
+				const auto vertex = data + (z * size + x) * stride;
+				const float position[4]{ float(x), float(gridHeight(x, z)), float(z), 1 };
+				if (type == VET_HALF4)
+				{
+					auto half = reinterpret_cast<uint16*>(vertex);
+					for (const auto i : { 0, 1, 2, 3 })
+						half[i] = Bitwise::floatToHalf(position[i]);
+				}
+				else
+					std::memcpy(vertex, position, 3 * sizeof(float));
+			}
+	}
+
+	///Triangle list indices of a grid of size x size vertices
+	std::vector<uint32> gridIndices(size_t size)
+	{
+		std::vector<uint32> indices;
+		indices.reserve(6 * (size - 1) * (size - 1));
+		for (auto z = size_t{ 0U }; z + 1 < size; ++z)
+			for (auto x = size_t{ 0U }; x + 1 < size; ++x)
+			{
+				const auto i = uint32(z * size + x);
+				const auto below = uint32(i + size);
+				indices.insert(indices.end(), { i, below, i + 1, i + 1, below, below + 1 });
+			}
+		return indices;
+	}
+
+	///Create v1 vertex data holding a grid, with an optional blend index element (one bone per band of rows) for the animated converter
+	v1::VertexData* createGridVertexData(size_t size, VertexElementType positionType, size_t boneCount)
+	{
+		auto& bufferManager = v1::HardwareBufferManager::getSingleton();
+		auto vertexData = OGRE_NEW v1::VertexData();
+		vertexData->vertexCount = size * size;
+
+		vertexData->vertexDeclaration->addElement(0, 0, positionType, VES_POSITION);
+		const auto vertexSize = v1::VertexElement::getTypeSize(positionType);
+		auto positions = bufferManager.createVertexBuffer(vertexSize, vertexData->vertexCount, v1::HardwareBuffer::HBU_STATIC, true);
+		writeGridPositions(static_cast<unsigned char*>(positions->lock(v1::HardwareBuffer::HBL_DISCARD)), size, positionType, vertexSize);
+		positions->unlock();
+		vertexData->vertexBufferBinding->setBinding(0, positions);
+
+		if (boneCount)
+		{
+			vertexData->vertexDeclaration->addElement(1, 0, VET_UBYTE4, VES_BLEND_INDICES);
+			auto bones = bufferManager.createVertexBuffer(4, vertexData->vertexCount, v1::HardwareBuffer::HBU_STATIC, true);
+			auto boneData = static_cast<uint8*>(bones->lock(v1::HardwareBuffer::HBL_DISCARD));
+			for (auto i = size_t{ 0U }; i < vertexData->vertexCount; ++i)
+			{
+				const auto bone = uint8((i / size) * boneCount / size);
+				boneData[4 * i] = boneData[4 * i + 1] = boneData[4 * i + 2] = boneData[4 * i + 3] = bone;
+			}
+			bones->unlock();
+			vertexData->vertexBufferBinding->setBinding(1, bones);
+		}
+
+		return vertexData;
+	}
+
+	///Create a v1 mesh of a grid, cut in bands of rows that are each their own submesh
+	v1::MeshPtr createGridMesh(const String& name, size_t size, VertexElementType positionType, size_t subMeshCount = 1)
+	{
+		auto mesh = v1::MeshManager::getSingleton().createManual(name, ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+		const auto indices = gridIndices(size);
+		const auto bandTriangles = (indices.size() / 3 + subMeshCount - 1) / subMeshCount;
+
+		for (auto band = size_t{ 0U }; band < subMeshCount; ++band)
+		{
+			const auto begin = std::min(indices.size(), 3 * band * bandTriangles);
+			const auto count = std::min(indices.size() - begin, 3 * bandTriangles);
+
+			auto subMesh = mesh->createSubMesh();
+			subMesh->useSharedVertices = false;
+			subMesh->vertexData[v1::VpNormal] = createGridVertexData(size, positionType, 0);
+
+			auto indexData = subMesh->indexData[v1::VpNormal];
+			indexData->indexCount = count;
+			indexData->indexBuffer = v1::HardwareBufferManager::getSingleton().createIndexBuffer(
+				v1::HardwareIndexBuffer::IT_32BIT, std::max<size_t>(count, 1), v1::HardwareBuffer::HBU_STATIC, true);
+			if (count) indexData->indexBuffer->writeData(0, count * sizeof(uint32), indices.data() + begin, true);
+		}
+
+		mesh->_setBounds(AxisAlignedBox(Vector3(0, -1, 0), Vector3(Real(size), 1, Real(size))));
+		mesh->_setBoundingSphereRadius(Real(size));
+		mesh->prepareForShadowMapping(true);
+		mesh->load();
+		return mesh;
+	}
+
+	///Try to start the NULL render system, that provides the VaoManager needed by v2 meshes without any GPU
+	bool initialiseNullRenderSystem(Root& root, const String& plugin)
+	{
+		try
+		{
+			root.loadPlugin(plugin);
+		}
+		catch (const Exception&)
+		{
+			return false;
+		}
+
+		const auto renderSystem = root.getRenderSystemByName("NULL Rendering Subsystem");
+		if (!renderSystem) return false;
+
+		root.setRenderSystem(renderSystem);
+		root.initialise(false);
+		root.createRenderWindow("BtOgre21_bench", 1, 1, false);
+		return true;
+	}
+
+	///Gives access to the animated vertex loader without an Entity (and so without a SceneManager and a skeleton)
+	class BenchAnimatedConverter : public BtOgre::AnimatedMeshToShapeConverter
+	{
+	public:
+		void addSkinnedVertexData(const v1::VertexData* vertexData)
+		{
+			addAnimatedVertexData(vertexData, vertexData, nullptr);
+		}
+	};
+
+	///Benchmark every shape creation of a converter whose geometry is already extracted
+	void benchCreateShapes(Bench& bench, const String& source, BtOgre::StaticMeshToShapeConverter& converter)
+	{
+		const auto vertices = converter.getVertexCount();
+		const auto triangles = converter.getTriangleCount();
+
+		bench.run("create/box/" + source, vertices, triangles, [&](ShapeList& shapes) { shapes.push_back(converter.createBox()); });
+		bench.run("create/sphere/" + source, vertices, triangles, [&](ShapeList& shapes) { shapes.push_back(converter.createSphere()); });
+		bench.run("create/cylinder/" + source, vertices, triangles, [&](ShapeList& shapes) { shapes.push_back(converter.createCylinder()); });
+		bench.run("create/capsule/" + source, vertices, triangles, [&](ShapeList& shapes) { shapes.push_back(converter.createCapsule()); });
+		bench.run("create/convex/" + source, vertices, triangles, [&](ShapeList& shapes) { shapes.push_back(converter.createConvex()); });
+		bench.run("create/trimesh/" + source, vertices, triangles, [&](ShapeList& shapes) { shapes.push_back(converter.createTrimesh()); });
+		bench.run("create/compound/" + source, vertices, triangles, [&](ShapeList& shapes) { shapes.push_back(converter.createPrimitiveCompound()); });
+
+		converter.setMortonOrdering(true);
+		bench.run("create/trimesh_morton/" + source, vertices, triangles, [&](ShapeList& shapes) { shapes.push_back(converter.createTrimesh()); });
+		converter.setMortonOrdering(false);
+	}
+
+	///Benchmark the extraction from a v1 mesh, then every shape creation from it
+	void benchV1Mesh(Bench& bench, const String& source, v1::MeshPtr mesh, bool createShapes)
+	{
+		BtOgre::StaticMeshToShapeConverter converter(mesh.get());
+		const auto vertices = converter.getVertexCount();
+		const auto triangles = converter.getTriangleCount();
+
+		bench.run("v1/extract/" + source, vertices, triangles, [&](ShapeList&)
+		{
+			BtOgre::StaticMeshToShapeConverter extraction(mesh.get());
+			extraction.getVertexCount();
+		});
+
+		if (createShapes) benchCreateShapes(bench, source, converter);
+	}
+
+	///Benchmark the extraction from the v2 import of a v1 mesh, with float and half positions
+	void benchV2Mesh(Bench& bench, const String& source, v1::MeshPtr v1Mesh, bool renderSystem)
+	{
+		for (const auto halfPosition : { false, true })
+		{
+			const auto name = "v2/extract/" + source + (halfPosition ? "_half" : "_float");
+			if (!renderSystem)
+			{
+				bench.skip(name, "v2 meshes need the NULL render system plugin");
+				continue;
+			}
+
+			auto mesh = MeshManager::getSingleton().createManual(v1Mesh->getName() + (halfPosition ? " v2 half" : " v2"), ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+			mesh->importV1(v1Mesh.get(), halfPosition, false, false);
+
+			BtOgre::StaticMeshToShapeConverter converter;
+			converter.addMesh(mesh.get());
+			bench.run(name, converter.getVertexCount(), converter.getTriangleCount(), [&](ShapeList&)
+			{
+				BtOgre::StaticMeshToShapeConverter extraction;
+				extraction.addMesh(mesh.get());
+				extraction.getVertexCount();
+			});
+
+			//The compound is fitted per submesh, so each submesh with triangles must give one child
+			auto subMeshes = 0;
+			for (auto i = 0; i < v1Mesh->getNumSubMeshes(); ++i)
+				if (v1Mesh->getSubMesh(i)->indexData[v1::VpNormal]->indexCount >= 3) ++subMeshes;
+			const auto compound = converter.createPrimitiveCompound();
+			bench.check(name, compound->getNumChildShapes() == subMeshes, std::to_string(compound->getNumChildShapes())
+				+ " compound children for " + std::to_string(subMeshes) + " submeshes");
+			destroyShape(compound);
+
+			MeshManager::getSingleton().remove(mesh->getHandle());
+		}
+	}
+
+	///Benchmark the raw buffer path with float and half positions
+	void benchRawGeometry(Bench& bench, size_t size)
+	{
+		const auto indices = gridIndices(size);
+		for (const auto type : { VET_FLOAT3, VET_HALF4 })
+		{
+			const auto stride = v1::VertexElement::getTypeSize(type);
+			std::vector<unsigned char> positions(size * size * stride);
+			writeGridPositions(positions.data(), size, type, stride);
+
+			bench.run(String("raw/extract/grid_") + (type == VET_HALF4 ? "half4" : "float3"), size * size, indices.size() / 3, [&](ShapeList&)
+			{
+				BtOgre::StaticMeshToShapeConverter converter;
+				converter.addRawGeometry(positions.data(), stride, type, size * size,
+					indices.data(), IndexBufferPacked::IT_32BIT, indices.size());
+			});
+		}
+	}
+
+	///Check that a planar mesh, a floor, gives compound children that keep a positive thickness
+	void checkPlanarCompound(Bench& bench, size_t size)
+	{
+		std::vector<float> positions;
+		positions.reserve(3 * size * size);
+		for (auto z = size_t{ 0U }; z < size; ++z)
+			for (auto x = size_t{ 0U }; x < size; ++x)
+				positions.insert(positions.end(), { float(x), 0.0f, float(z) });
+		const auto indices = gridIndices(size);
+
+		BtOgre::StaticMeshToShapeConverter converter;
+		converter.addRawGeometry(positions.data(), 3 * sizeof(float), VET_FLOAT3, size * size,
+			indices.data(), IndexBufferPacked::IT_32BIT, indices.size());
+		const auto compound = converter.createPrimitiveCompound();
+
+		const auto name = String("create/compound/planar_grid");
+		bench.check(name, compound->getNumChildShapes() == 1, std::to_string(compound->getNumChildShapes()) + " compound children for 1 submesh");
+		for (auto i = 0; i < compound->getNumChildShapes(); ++i)
+		{
+			const auto child = compound->getChildShape(i);
+			btVector3 min, max;
+			child->getAabb(btTransform::getIdentity(), min, max);
+			const auto extent = max - min;
+			bench.check(name, extent.x() > 0 && extent.y() > 0 && extent.z() > 0, "child " + std::to_string(i) + " has no thickness");
+
+			//Box, cylinder and capsule keep their extents minus the margin, they must not go negative
+			const auto type = child->getShapeType();
+			if (type == BOX_SHAPE_PROXYTYPE || type == CYLINDER_SHAPE_PROXYTYPE || type == CAPSULE_SHAPE_PROXYTYPE)
+			{
+				const auto dimensions = static_cast<btConvexInternalShape*>(child)->getImplicitShapeDimensions();
+				bench.check(name, dimensions.x() >= 0 && dimensions.y() >= 0 && dimensions.z() >= 0,
+					"child " + std::to_string(i) + " has a negative implicit dimension");
+			}
+		}
+		destroyShape(compound);
+	}
+
+	///Benchmark the mesh file path
+	void benchMeshFile(Bench& bench, const String& path, const String& source)
+	{
+		std::ifstream file(path, std::ios::binary);
+		const std::vector<unsigned char> content{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+		BtOgre::MeshFileReader reader(content.data(), content.size());
+		BtOgre::StaticMeshToShapeConverter converter(reader);
+		bench.run("meshfile/extract/" + source, converter.getVertexCount(), converter.getTriangleCount(), [&](ShapeList&)
+		{
+			BtOgre::MeshFileReader extractionReader(content.data(), content.size());
+			BtOgre::StaticMeshToShapeConverter extraction(extractionReader);
+			extraction.getVertexCount();
+		});
+	}
+
+	///Benchmark the animated converter: per bone vertex extraction, and the aligned and oriented bone boxes
+	void benchAnimated(Bench& bench, size_t size)
+	{
+		const auto boneCount = size_t{ 32U };
+		const auto source = "skinned_grid_" + std::to_string(boneCount) + "_bones";
+		auto vertexData = createGridVertexData(size, VET_FLOAT3, boneCount);
+
+		bench.run("animated/extract/" + source, size * size, 0, [&](ShapeList&)
+		{
+			BenchAnimatedConverter extraction;
+			extraction.addSkinnedVertexData(vertexData);
+		});
+
+		BenchAnimatedConverter converter;
+		converter.addSkinnedVertexData(vertexData);
+		const auto orientation = Quaternion(Degree(30), Vector3::UNIT_Y);
+
+		bench.run("animated/aligned_box/" + source, size * size, 0, [&](ShapeList& shapes)
+		{
+			for (auto bone = size_t{ 0U }; bone < boneCount; ++bone)
+				if (const auto box = converter.createAlignedBox(uint8(bone), Vector3::ZERO, orientation))
+					shapes.push_back(box);
+		});
+
+		bench.run("animated/oriented_box/" + source, size * size, 0, [&](ShapeList& shapes)
+		{
+			for (auto bone = size_t{ 0U }; bone < boneCount; ++bone)
+				if (const auto box = converter.createOrientedBox(uint8(bone), Vector3::ZERO, orientation))
+					shapes.push_back(box);
+		});
+
+		OGRE_DELETE vertexData;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (auto i = 1; i < argc; ++i)
+	{
+		const String arg{ argv[i] };
+		const auto hasValue = i + 1 < argc;
+
+		//The numeric values are parsed with std::stoul/std::stoi, that throw on anything but a number
+		try
+		{
+			if (arg == "-d" && hasValue) options.dataDirectory = argv[++i];
+			else if (arg == "-n" && hasValue) options.gridSize = std::max<size_t>(2, std::stoul(argv[++i]));
+			else if (arg == "-i" && hasValue) options.iterations = std::max<size_t>(1, std::stoul(argv[++i]));
+			else if (arg == "-o" && hasValue) options.output = argv[++i];
+			else if (arg == "-r" && hasValue) options.nullRenderSystem = argv[++i];
+			else
+			{
+				usage();
+				return arg == "-h" || arg == "--help" ? 0 : 1;
+			}
+		}
+		catch (const std::exception&)
+		{
+			std::cerr << "invalid value " << argv[i] << " for " << arg << "\n";
+			usage();
+			return 1;
+		}
+	}
+
+	//Created before the Root so Ogre doesn't log to stdout, where the results go
+	auto logManager = new LogManager;
+	logManager->createLog("BtOgre21_bench.log", true, false, false);
+
+	auto root = new Root("", "", "");
+	const auto renderSystem = initialiseNullRenderSystem(*root, options.nullRenderSystem);
+
+	//Without a render system, v1 meshes can still live in system memory
+	v1::HardwareBufferManager* softwareBufferManager{ nullptr };
+	if (!renderSystem)
+		softwareBufferManager = OGRE_NEW v1::DefaultHardwareBufferManager;
+
+	Bench bench(options.iterations);
+	{
+		const auto gridSource = "grid_" + std::to_string(options.gridSize);
+		auto floatGrid = createGridMesh("BtOgreBenchGridFloat", options.gridSize, VET_FLOAT3);
+		auto halfGrid = createGridMesh("BtOgreBenchGridHalf", options.gridSize, VET_HALF4);
+		auto bandedGrid = createGridMesh("BtOgreBenchGridBands", options.gridSize, VET_FLOAT3, 4);
+
+		benchV1Mesh(bench, gridSource + "_float3", floatGrid, true);
+		benchV1Mesh(bench, gridSource + "_half4", halfGrid, false);
+		benchV2Mesh(bench, gridSource, floatGrid, renderSystem);
+		benchV2Mesh(bench, gridSource + "_4_submeshes", bandedGrid, renderSystem);
+		benchRawGeometry(bench, options.gridSize);
+		checkPlanarCompound(bench, 16);
+		benchAnimated(bench, options.gridSize);
+
+		//The meshes of the demo
+		try
+		{
+			ResourceGroupManager::getSingleton().addResourceLocation(options.dataDirectory, "FileSystem", "BtOgreBench");
+			ResourceGroupManager::getSingleton().initialiseResourceGroup("BtOgreBench");
+		}
+		catch (const Exception& e)
+		{
+			std::cerr << e.getDescription() << "\n";
+		}
+
+		for (const auto meshName : { "Player.mesh", "TestLevel_b0.mesh" })
+		{
+			const String source{ meshName };
+			v1::MeshPtr mesh;
+			try
+			{
+				mesh = v1::MeshManager::getSingleton().load(meshName, "BtOgreBench", v1::HardwareBuffer::HBU_STATIC, v1::HardwareBuffer::HBU_STATIC);
+			}
+			catch (const Exception&)
+			{
+				for (const auto name : { "v1/extract/", "v2/extract/", "meshfile/extract/" })
+					bench.skip(name + source, "cannot load " + source + " from " + options.dataDirectory);
+				continue;
+			}
+
+			benchV1Mesh(bench, source, mesh, true);
+			benchV2Mesh(bench, source, mesh, renderSystem);
+			benchMeshFile(bench, options.dataDirectory + "/" + meshName, source);
+		}
+	}
+
+	if (options.output.empty())
+	{
+		bench.writeJson(std::cout, options);
+	}
+	else
+	{
+		std::ofstream output(options.output);
+		bench.writeJson(output, options);
+	}
+
+	//The meshes have to go before the buffer manager they were created with
+	v1::MeshManager::getSingleton().removeAll();
+	OGRE_DELETE softwareBufferManager;
+	delete root;
+	delete logManager;
+
+	return bench.passed() ? 0 : 1;
+}
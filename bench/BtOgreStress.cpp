@@ -0,0 +1,333 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreStress.cpp
+ *
+ *    Description:  Headless stress scenario: N rigid bodies driving Ogre scene nodes
+ *                  through BtOgre motion states, with the debug drawer on. Reports the
+ *                  frame time split by stage as JSON.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+//C++ standard library
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//Ogre includes
+#include <Ogre.h>
+#include <Hlms/Unlit/OgreHlmsUnlit.h>
+
+//BtOgre includes
+#include <BtOgre.hpp>
+
+using namespace Ogre;
+
+namespace
+{
+	///Command line options
+	struct Options
+	{
+		///Number of dynamic bodies
+		size_t bodies{ 10000 };
+
+		///Number of simulated frames
+		size_t frames{ 300 };
+
+		///Bullet debug draw mode, 0 to disable debug drawing
+		int debugMode{ btIDebugDraw::DBG_DrawWireframe };
+
+		///Ogre media directory containing the Hlms folder. Needed to upload the debug lines
+		String mediaDirectory;
+
+		///File to write the results to, stdout if empty
+		String output;
+
+		///Plugin of the NULL render system
+		String nullRenderSystem{ "RenderSystem_NULL" };
+	};
+
+	void usage()
+	{
+		std::cerr << "Usage: BtOgre21_stress [options]\n"
+			<< "  -n <bodies>      Number of dynamic bodies (default: 10000)\n"
+			<< "  -f <frames>      Number of frames to simulate (default: 300)\n"
+			<< "  -g <mode>        Bullet debug draw mode, 0 to disable (default: 1, wireframe)\n"
+			<< "  -u <directory>   Ogre media directory with the Hlms folder, to time the debug line upload\n"
+			<< "  -o <file>        Write the JSON results to a file instead of stdout\n"
+			<< "  -r <plugin>      NULL render system plugin (default: RenderSystem_NULL)\n";
+	}
+
+	///Dynamics world that only synchronizes the motion states when asked, so the node sync can be timed apart from the simulation
+	class StressWorld : public btDiscreteDynamicsWorld
+	{
+	public:
+		using btDiscreteDynamicsWorld::btDiscreteDynamicsWorld;
+
+		///Called at the end of stepSimulation()
+		void synchronizeMotionStates() override
+		{
+			if (mSynchronize) btDiscreteDynamicsWorld::synchronizeMotionStates();
+		}
+
+		///Push the transforms of the bodies to the motion states
+		void synchronizeNow()
+		{
+			mSynchronize = true;
+			synchronizeMotionStates();
+			mSynchronize = false;
+		}
+
+	private:
+		bool mSynchronize{ false };
+	};
+
+	///Timings of one stage of the frame, in milliseconds
+	struct Stage
+	{
+		String name;
+		std::vector<double> timings;
+	};
+
+	///Register HlmsUnlit from the Ogre media directory, the debug drawer needs it to create its datablock
+	void registerHlmsUnlit(const String& mediaDirectory)
+	{
+		auto dataFolder = mediaDirectory;
+		if (dataFolder.back() != '/') dataFolder += '/';
+		dataFolder += "Hlms/";
+
+		String dataFolderPath;
+		StringVector libraryFoldersPaths;
+		HlmsUnlit::getDefaultPaths(dataFolderPath, libraryFoldersPaths);
+
+		auto archiveUnlit = ArchiveManager::getSingleton().load(dataFolder + dataFolderPath, "FileSystem", true);
+		ArchiveVec archiveUnlitLibraryFolders;
+		for (const auto& libraryFolderPath : libraryFoldersPaths)
+			archiveUnlitLibraryFolders.push_back(ArchiveManager::getSingleton().load(dataFolder + libraryFolderPath, "FileSystem", true));
+
+		auto hlmsUnlit = OGRE_NEW HlmsUnlit(archiveUnlit, &archiveUnlitLibraryFolders);
+		Root::getSingleton().getHlmsManager()->registerHlms(hlmsUnlit);
+		hlmsUnlit->setDebugOutputPath(false, false);
+	}
+
+	///Write the per stage statistics as a JSON document
+	void writeJson(std::ostream& output, const Options& options, const std::vector<Stage>& stages, double meanLines)
+	{
+		output << "{\n"
+			<< "  \"suite\": \"BtOgre21_stress\",\n"
+			<< "  \"bodies\": " << options.bodies << ",\n"
+			<< "  \"frames\": " << options.frames << ",\n"
+			<< "  \"debug_mode\": " << options.debugMode << ",\n"
+			<< "  \"mean_lines_per_frame\": " << meanLines << ",\n"
+			<< "  \"stages\": [";
+
+		for (auto i = size_t{ 0U }; i < stages.size(); ++i)
+		{
+			const auto& stage = stages[i];
+			output << (i ? ",\n" : "\n") << "    { \"name\": \"" << stage.name << "\"";
+
+			if (stage.timings.empty())
+			{
+				output << ", \"skipped\": true }";
+				continue;
+			}
+
+			auto sorted = stage.timings;
+			std::sort(sorted.begin(), sorted.end());
+			const auto total = std::accumulate(sorted.begin(), sorted.end(), 0.0);
+
+			output << ", \"mean_ms\": " << total / sorted.size()
+				<< ", \"median_ms\": " << sorted[sorted.size() / 2]
+				<< ", \"p99_ms\": " << sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)]
+				<< ", \"max_ms\": " << sorted.back()
+				<< ", \"total_ms\": " << total << " }";
+		}
+
+		output << "\n  ]\n}\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (auto i = 1; i < argc; ++i)
+	{
+		const String arg{ argv[i] };
+		const auto hasValue = i + 1 < argc;
+
+		//The numeric values are parsed with std::stoul/std::stoi, that throw on anything but a number
+		try
+		{
+			if (arg == "-n" && hasValue) options.bodies = std::stoul(argv[++i]);
+			else if (arg == "-f" && hasValue) options.frames = std::max<size_t>(1, std::stoul(argv[++i]));
+			else if (arg == "-g" && hasValue) options.debugMode = std::stoi(argv[++i]);
+			else if (arg == "-u" && hasValue) options.mediaDirectory = argv[++i];
+			else if (arg == "-o" && hasValue) options.output = argv[++i];
+			else if (arg == "-r" && hasValue) options.nullRenderSystem = argv[++i];
+			else
+			{
+				usage();
+				return arg == "-h" || arg == "--help" ? 0 : 1;
+			}
+		}
+		catch (const std::exception&)
+		{
+			std::cerr << "invalid value " << argv[i] << " for " << arg << "\n";
+			usage();
+			return 1;
+		}
+	}
+
+	//Created before the Root so Ogre doesn't log to stdout, where the results go
+	auto logManager = new LogManager;
+	logManager->createLog("BtOgre21_stress.log", true, false, false);
+
+	//The NULL render system gives a SceneManager and a VaoManager without any window or GPU
+	auto root = new Root("", "", "");
+	try
+	{
+		root->loadPlugin(options.nullRenderSystem);
+	}
+	catch (const Exception& e)
+	{
+		std::cerr << "Cannot load " << options.nullRenderSystem << " : " << e.getDescription() << "\n";
+		delete root;
+		delete logManager;
+		return 1;
+	}
+
+	root->setRenderSystem(root->getRenderSystemByName("NULL Rendering Subsystem"));
+	root->initialise(false);
+	root->createRenderWindow("BtOgre21_stress", 1, 1, false);
+
+	const auto uploadLines = options.debugMode && !options.mediaDirectory.empty();
+	if (uploadLines) registerHlmsUnlit(options.mediaDirectory);
+
+	auto sceneManager = root->createSceneManager(ST_GENERIC, 1, INSTANCING_CULLING_SINGLETHREAD, "BtOgreStress");
+
+	//Physics world
+	auto broadphase = new btDbvtBroadphase;
+	auto collisionConfig = new btDefaultCollisionConfiguration;
+	auto dispatcher = new btCollisionDispatcher(collisionConfig);
+	auto solver = new btSequentialImpulseConstraintSolver;
+	auto world = new StressWorld(dispatcher, broadphase, solver, collisionConfig);
+	world->setGravity({ 0, -9.81f, 0 });
+
+	auto debugDrawer = new BtOgre::DebugDrawer(sceneManager->getRootSceneNode(), world, sceneManager);
+	debugDrawer->setDebugMode(options.debugMode);
+	world->setDebugDrawer(debugDrawer);
+
+	//Ground
+	auto groundShape = new btStaticPlaneShape({ 0, 1, 0 }, 0);
+	auto groundBody = new btRigidBody(0, nullptr, groundShape);
+	world->addRigidBody(groundBody);
+
+	//Columns of boxes, so the bodies keep colliding and stay active for a while
+	const auto boxShape = new btBoxShape({ 0.5f, 0.5f, 0.5f });
+	btVector3 inertia;
+	boxShape->calculateLocalInertia(1, inertia);
+
+	const auto columns = std::max<size_t>(1, size_t(std::sqrt(double(options.bodies) / 10)));
+	std::vector<btRigidBody*> bodies;
+	bodies.reserve(options.bodies);
+	for (auto i = size_t{ 0U }; i < options.bodies; ++i)
+	{
+		const auto column = i % (columns * columns);
+		const auto level = i / (columns * columns);
+		const Vector3 position{ Real(column % columns) * 1.5f, 0.5f + Real(level) * 1.05f, Real(column / columns) * 1.5f };
+
+		auto node = sceneManager->getRootSceneNode()->createChildSceneNode(SCENE_DYNAMIC, position);
+		auto state = new BtOgre::RigidBodyState(node);
+		auto body = new btRigidBody(1, state, boxShape, inertia);
+		world->addRigidBody(body);
+		bodies.push_back(body);
+	}
+
+	std::vector<Stage> stages{ { "simulation", {} }, { "node_sync", {} }, { "scene_graph", {} }, { "debug_collect", {} }, { "debug_upload", {} }, { "frame", {} } };
+	for (auto& stage : stages)
+		stage.timings.reserve(options.frames);
+
+	const auto elapsed = [](std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	};
+
+	auto lineCount = size_t{ 0U };
+	for (auto frame = size_t{ 0U }; frame < options.frames; ++frame)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		world->stepSimulation(1 / 60.f, 1, 1 / 60.f);
+		const auto simulated = std::chrono::steady_clock::now();
+		world->synchronizeNow();
+		const auto synchronized = std::chrono::steady_clock::now();
+		sceneManager->updateSceneGraph();
+		const auto updated = std::chrono::steady_clock::now();
+		debugDrawer->collectLines();
+		const auto collected = std::chrono::steady_clock::now();
+		if (uploadLines) debugDrawer->uploadLines();
+		const auto uploaded = std::chrono::steady_clock::now();
+
+		//Without upload, the line buffer still has to be emptied for the next frame. Turning the drawer off clears it
+		lineCount += debugDrawer->getLineCount();
+		if (!uploadLines)
+		{
+			debugDrawer->setDebugMode(0);
+			debugDrawer->setDebugMode(options.debugMode);
+		}
+
+		stages[0].timings.push_back(elapsed(start, simulated));
+		stages[1].timings.push_back(elapsed(simulated, synchronized));
+		stages[2].timings.push_back(elapsed(synchronized, updated));
+		if (options.debugMode) stages[3].timings.push_back(elapsed(updated, collected));
+		if (uploadLines) stages[4].timings.push_back(elapsed(collected, uploaded));
+		stages[5].timings.push_back(elapsed(start, uploaded));
+	}
+
+	const auto meanLines = double(lineCount) / options.frames;
+	if (options.output.empty())
+	{
+		writeJson(std::cout, options, stages, meanLines);
+	}
+	else
+	{
+		std::ofstream output(options.output);
+		writeJson(output, options, stages, meanLines);
+	}
+
+	//Cleanup
+	for (auto body : bodies)
+	{
+		world->removeRigidBody(body);
+		delete body->getMotionState();
+		delete body;
+	}
+	world->removeRigidBody(groundBody);
+	delete groundBody;
+	delete groundShape;
+	delete boxShape;
+
+	world->setDebugDrawer(nullptr);
+	delete debugDrawer;
+	delete world;
+	delete solver;
+	delete dispatcher;
+	delete collisionConfig;
+	delete broadphase;
+
+	delete root;
+	delete logManager;
+
+	return 0;
+}
@@ -54,16 +54,8 @@ protected:
 	//BtOgre debug drawer object
 	BtOgre::DebugDrawer* mDebugDrawer;
 
-	//A physics object that is put on the scene
-	SceneNode* mNinjaNode;
-	Item* mNinjaItem;
-	btRigidBody* mNinjaBody;
-	btCollisionShape* mNinjaShape;
-
-	//The "landscape" of the scene
-	Item* mGroundItem;
-	btRigidBody* mGroundBody;
-	btCollisionShape* mGroundShape;
+	//Owner of every physics object put on the scene, with their motion state and collision shape
+	BtOgre::BodyRegistry* mBodies;
 
 	//Ogre important objects
 	Root* mRoot;
@@ -86,13 +78,7 @@ protected:
 public:
 	BtOgreTestApplication() :
 		mDebugDrawer(nullptr),
-		mNinjaNode(nullptr),
-		mNinjaItem(nullptr),
-		mNinjaBody(nullptr),
-		mNinjaShape(nullptr),
-		mGroundItem(nullptr),
-		mGroundBody(nullptr),
-		mGroundShape(nullptr),
+		mBodies(nullptr),
 		mRoot(nullptr),
 		mSceneMgr(nullptr),
 		mCamera(nullptr),
@@ -112,23 +98,14 @@ public:
 		mSolver = new btSequentialImpulseConstraintSolver();
 		phyWorld = new btDiscreteDynamicsWorld(mDispatcher, mBroadphase, mSolver, mCollisionConfig);
 		phyWorld->setGravity(btVector3(0, -9.8, 0));
+
+		mBodies = new BtOgre::BodyRegistry(phyWorld);
 	}
 
 	~BtOgreTestApplication()
 	{
-		//Free rigid bodies
-		phyWorld->removeRigidBody(mNinjaBody);
-		delete mNinjaBody->getMotionState();
-		delete mNinjaBody;
-		delete mNinjaShape;
-
-		phyWorld->removeRigidBody(mGroundBody);
-		delete mGroundBody->getMotionState();
-		delete mGroundBody;
-
-		//Here's a quirk of the cleanup of a "triangle" based collision shape: You need to delete the mesh interface
-		delete reinterpret_cast<btTriangleMeshShape*>(mGroundShape)->getMeshInterface();
-		delete mGroundShape;
+		//Free rigid bodies, with their motion states and shapes (the mesh interface of the ground trimesh included)
+		delete mBodies;
 
 		//Free Bullet stuff.
 		delete mDebugDrawer;
@@ -226,29 +203,21 @@ protected:
 		auto rot = Quaternion::IDENTITY;
 
 		auto ninjaMesh = asV2mesh("Player.mesh", ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, std::to_string(physicsObjectCount));
-		mNinjaItem = mSceneMgr->createItem(ninjaMesh);
+		auto ninjaItem = mSceneMgr->createItem(ninjaMesh);
 
-		mNinjaItem->setName(physicsNodeName);
-		mNinjaNode = mSceneMgr->getRootSceneNode()->createChildSceneNode(SCENE_DYNAMIC, pos, rot);
-		mNinjaNode->setName(physicsNodeName);
+		ninjaItem->setName(physicsNodeName);
+		auto ninjaNode = mSceneMgr->getRootSceneNode()->createChildSceneNode(SCENE_DYNAMIC, pos, rot);
+		ninjaNode->setName(physicsNodeName);
 		physicsObjectCount += 1;
-		mNinjaNode->attachObject(mNinjaItem);
+		ninjaNode->attachObject(ninjaItem);
 
 		//Create shape.
-		BtOgre::StaticMeshToShapeConverter converter(mNinjaItem);
-		mNinjaShape = converter.createSphere();
+		BtOgre::StaticMeshToShapeConverter converter(ninjaItem);
+		auto ninjaShape = converter.createSphere();
 
-		//Calculate inertia.
+		//Create the Body, with a BtOgre MotionState (connects Ogre and Bullet), and add it to the world.
 		btScalar mass = 5;
-		btVector3 inertia;
-		mNinjaShape->calculateLocalInertia(mass, inertia);
-
-		//Create BtOgre MotionState (connects Ogre and Bullet).
-		auto ninjaState = new BtOgre::RigidBodyState(mNinjaNode);
-
-		//Create the Body.
-		mNinjaBody = new btRigidBody(mass, ninjaState, mNinjaShape, inertia);
-		phyWorld->addRigidBody(mNinjaBody);
+		mBodies->create(mass, ninjaShape, ninjaNode, ninjaItem);
 	}
 
 	void createScene()
@@ -275,18 +244,14 @@ protected:
 
 		//Create the ground
 		const auto groundMesh = asV2mesh("TestLevel_b0.mesh");
-		mGroundItem = mSceneMgr->createItem(groundMesh);
-		mSceneMgr->getRootSceneNode()->createChildSceneNode()->attachObject(mGroundItem);
-		BtOgre::StaticMeshToShapeConverter converter2(mGroundItem);
-		mGroundShape = converter2.createTrimesh();
-
-		//Create MotionState (no need for BtOgre here, you can use it if you want to though).
-		const auto groundState = new btDefaultMotionState(
-			btTransform(btQuaternion(0, 0, 0, 1), btVector3(0, 0, 0)));
-
-		//Create the Body.
-		mGroundBody = new btRigidBody(0, groundState, mGroundShape, btVector3(0, 0, 0));
-		phyWorld->addRigidBody(mGroundBody);
+		auto groundItem = mSceneMgr->createItem(groundMesh);
+		auto groundNode = mSceneMgr->getRootSceneNode()->createChildSceneNode();
+		groundNode->attachObject(groundItem);
+		BtOgre::StaticMeshToShapeConverter converter2(groundItem);
+		auto groundShape = converter2.createTrimesh();
+
+		//Create the static Body (mass 0).
+		mBodies->create(0, groundShape, groundNode, groundItem);
 	}
 
 	void setup()
@@ -21,3 +21,11 @@
 #include "BtOgreGP.h"
 #include "BtOgrePG.h"
 #include "BtOgreExtras.h"
+#include "BtOgreMeshFile.h"
+#include "BtOgreShapeCache.h"
+#include "BtOgreProfiling.h"
+#include "BtOgreWorld.h"
+#include "BtOgreThreading.h"
+#include "BtOgreRegistry.h"
+#include "BtOgreQuery.h"
+#include "BtOgreCollisionEvents.h"
@@ -0,0 +1,166 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreCollisionEvents.h
+ *
+ *    Description:  Stream of begin, persist and end collision events built from the
+ *                  contact manifolds of a world after each step.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+#include "BtOgreRegistry.h"
+
+namespace BtOgre
+{
+	///Kind of collision event
+	enum class CollisionEventType
+	{
+		///The two objects started touching during the last step
+		Begin,
+
+		///The two objects were already touching, and still are
+		Persist,
+
+		///The two objects stopped touching (or one of them was removed)
+		End
+	};
+
+	///Contact between two objects, as seen after a step
+	struct CollisionEvent
+	{
+		///Kind of event
+		CollisionEventType type;
+
+		///First object. For an End event it may have been deleted already, check bodyA against the registry first
+		const btCollisionObject* objectA;
+
+		///Second object
+		const btCollisionObject* objectB;
+
+		///Handle of the first object, if the stream has a registry and the object is registered
+		BodyHandle bodyA;
+
+		///Handle of the second object
+		BodyHandle bodyB;
+
+		///Deepest contact point, on the surface of objectB. The last known one for an End event
+		Ogre::Vector3 point;
+
+		///Contact normal, pointing from objectB towards objectA
+		Ogre::Vector3 normal;
+
+		///Sum of the impulses applied by the solver on every contact point of the pair during the last step. 0 for an End event
+		Ogre::Real impulse;
+	};
+
+	///Collect the touching pairs of a world after each step, and turn them into Begin, Persist and End events stored in a ring buffer.
+	///The pairs of a step are sorted and diffed with the ones of the previous step, without any map. Every buffer is reused, so once
+	///warmed up nothing is allocated. If the ring is full, the oldest events are overwritten and counted as dropped
+	class CollisionEventStream
+	{
+	public:
+		///Watch the given world. The registry, if any, fills the handles of the events and keys the pairs with them
+		CollisionEventStream(btCollisionWorld* world, const BodyRegistry* registry = nullptr, size_t capacity = 4096);
+
+		///Collect the contacts of the last step and push the events. Call it after each step (e.g. after each PhysicsWorld step)
+		void update();
+
+		///Push Persist events too (the default), otherwise only Begin and End
+		void setReportPersist(bool report);
+
+		///Get the number of events waiting
+		size_t getEventCount() const;
+
+		///Get a waiting event, 0 being the oldest
+		const CollisionEvent& getEvent(size_t index) const;
+
+		///Take the oldest waiting event. Return false if there is none
+		bool pop(CollisionEvent& event);
+
+		///Call handler(const CollisionEvent&) on every waiting event, oldest first, then remove them all
+		template <typename Handler> void consume(const Handler& handler)
+		{
+			for (auto i = size_t{ 0U }; i < mCount; ++i)
+				handler(getEvent(i));
+			clear();
+		}
+
+		///Remove every waiting event
+		void clear();
+
+		///Get the number of events overwritten because the ring was full
+		size_t getDroppedCount() const;
+
+	private:
+		///A touching pair during a step
+		struct Pair
+		{
+			///Keys of the two objects, keyA < keyB
+			std::uint64_t keyA;
+			std::uint64_t keyB;
+
+			const btCollisionObject* objectA;
+			const btCollisionObject* objectB;
+			BodyHandle bodyA;
+			BodyHandle bodyB;
+			btVector3 point;
+			btVector3 normal;
+
+			///Distance of the deepest point, to merge the manifolds of a pair
+			btScalar distance;
+
+			btScalar impulse;
+
+			///Sort by keys
+			bool operator<(const Pair& other) const { return keyA != other.keyA ? keyA < other.keyA : keyB < other.keyB; }
+
+			///Same two objects
+			bool samePair(const Pair& other) const { return keyA == other.keyA && keyB == other.keyB; }
+		};
+
+		///Key of an object: its handle if registered, so a new object at the same address is another key, or its address
+		std::uint64_t getKey(const btCollisionObject* object, BodyHandle& handle) const;
+
+		///Add an event of the given pair to the ring
+		void push(CollisionEventType type, const Pair& pair, btScalar impulse);
+
+		///World watched
+		btCollisionWorld* mWorld;
+
+		///Registry keying the pairs
+		const BodyRegistry* mRegistry;
+
+		///Pairs of the last step, sorted
+		std::vector<Pair> mPairs;
+
+		///Pairs of the step before, sorted
+		std::vector<Pair> mPreviousPairs;
+
+		///Ring of events
+		std::vector<CollisionEvent> mEvents;
+
+		///Position of the oldest event in the ring
+		size_t mHead;
+
+		///Number of events in the ring
+		size_t mCount;
+
+		///Number of events overwritten
+		size_t mDropped;
+
+		///Push Persist events
+		bool mReportPersist;
+	};
+}
@@ -100,6 +100,9 @@ namespace BtOgre
 
 		///Update the content of the manual object with the line buffer
 		void update();
+
+		///Get the number of lines in the line buffer
+		size_t getLineCount() const;
 	};
 
 	///Debug Drawer, permit to visualize and debug the physics
@@ -185,7 +188,16 @@ namespace BtOgre
 		///get the current debug mode
 		int getDebugMode() const override;
 
-		///Step the debug drawer
+		///Step the debug drawer. Same as collectLines() then uploadLines()
 		void step();
+
+		///Let Bullet draw the world in the line buffer. Doesn't touch the manual object, so the cost of Bullet's line generation can be measured alone
+		void collectLines();
+
+		///Upload the line buffer to the manual object, and mark the debug drawer as stepped
+		void uploadLines();
+
+		///Get the number of lines drawn
+		size_t getLineCount() const;
 	};
 }
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <algorithm>
+#include <limits>
 
 #include <btBulletDynamicsCommon.h>
 #include <Ogre.h>
@@ -24,13 +25,17 @@
 #include <OgreSubMesh2.h>
 #include <OgreItem.h>
 #include <OgreBitwise.h>
+#include <OgreHlmsDatablock.h>
 
 #include <Vao/OgreAsyncTicket.h>
+#include <Vao/OgreIndexBufferPacked.h>
 #include <Vao/OgreVertexArrayObject.h>
 #include <Vao/OgreVertexBufferPacked.h>
 #include <Vao/OgreVertexElements.h>
 
 #include "BtOgreExtras.h"
+#include "BtOgreMeshFile.h"
+#include "BtOgreShapeCache.h"
 #include "BtOgre.hpp"
 
 namespace BtOgre
@@ -44,6 +49,48 @@ namespace BtOgre
 	///Type of an index buffer is an array of unsigned ints
 	using IndexBuffer = std::vector<unsigned int>;
 
+	///Material of a submesh that has been loaded by a converter
+	struct SubMeshMaterial
+	{
+		///Name of the material set on the submesh in the mesh
+		Ogre::String materialName;
+
+		///Datablock used by the Item or Entity the submesh was loaded from, nullptr if it was loaded from a bare mesh
+		Ogre::HlmsDatablock* datablock;
+	};
+
+	///Table that map the triangles of a trimesh to the submesh (and material) they come from.
+	///Use the triangleIndex of a contact point or of a ray test LocalShapeInfo to do a constant time lookup
+	class TriangleMaterialMap
+	{
+	public:
+		///Construct an empty map
+		TriangleMaterialMap() = default;
+
+		///Construct a map from the submesh index of each triangle, and the material of each submesh
+		TriangleMaterialMap(std::vector<unsigned short> triangleSubMesh, std::vector<SubMeshMaterial> subMeshMaterials);
+
+		///Get the index of the submesh a triangle comes from
+		unsigned short getSubMesh(int triangleIndex) const;
+
+		///Get the material of the submesh a triangle comes from
+		const SubMeshMaterial& getMaterial(int triangleIndex) const;
+
+		///Get the number of triangles in the table
+		size_t getTriangleCount() const;
+
+		///Get the number of submeshes in the table
+		size_t getSubMeshCount() const;
+
+	private:
+
+		///Submesh index of each triangle
+		std::vector<unsigned short> mTriangleSubMesh;
+
+		///Material of each submesh
+		std::vector<SubMeshMaterial> mSubMeshMaterials;
+	};
+
 	///
 	/// Converter from vertex and index buffer to Bullet BtCollisionShape. Load vertex and index buffer from Ogre Item, Etity, Mesh and v1::Mesh
 	///
@@ -71,6 +118,10 @@ namespace BtOgre
 		///Return a triangular mesh collision shape from this object
 		btBvhTriangleMeshShape* createTrimesh();
 
+		///Return a triangular mesh collision shape from this object, and the table to get the material of each of its triangles
+		/// \param materials : Output parameter where the triangle to material table will be written
+		btBvhTriangleMeshShape* createTrimesh(TriangleMaterialMap& materials);
+
 		///Return a cynlinder collision shape from this object
 		btCylinderShape* createCylinder();
 
@@ -80,23 +131,85 @@ namespace BtOgre
 		///Return a capsule shape from this object
 		btCapsuleShape* createCapsule();
 
+		///Return a compound made of one simple shape per submesh. Each submesh get the primitive (box, sphere, capsule, cylinder or small convex hull) that fits it best.
+		///Submeshes that no primitive fits within the tolerance are added as a trimesh. The child shapes (and the mesh interface of trimesh children) are owned by the caller.
+		/// \param maxFitError : Maximal RMS distance between the submesh surface and the primitive, relative to the submesh half size
+		/// \param maxHullVertices : Maximal number of vertices of a convex hull to be used instead of a trimesh. 0 to never use hulls
+		btCompoundShape* createPrimitiveCompound(Ogre::Real maxFitError = 0.05f, size_t maxHullVertices = 32);
+
 		///Get the vertex buffer (array of vector 3)
 		const Ogre::Vector3* getVertices();
 
 		///Get the vertex count (size of vertex buffer) of the object
-		size_t getVertexCount() const;
+		size_t getVertexCount();
 
 		///Get the index buffer of the object (array of unsigned ints)
 		const unsigned int* getIndices();
 
 		///Get the index count(size of vertex buffer) from this object
-		size_t getIndexCount() const;
+		size_t getIndexCount();
 
 		///Get the number of triangles
-		size_t getTriangleCount() const;
+		size_t getTriangleCount();
+
+		///Get the index of the submesh each triangle comes from
+		const std::vector<unsigned short>& getTriangleSubMeshes();
+
+		///Get the material of each submesh that was loaded, indexed by submesh
+		const std::vector<SubMeshMaterial>& getSubMeshMaterials();
+
+		///Get a table mapping the current triangles to their submesh and material. This table can outlive the converter
+		TriangleMaterialMap getTriangleMaterialMap();
+
+		///Sort the triangles by the Morton code of their centroid (and renumber the vertices to match) before building a trimesh.
+		///Neighbouring BVH leaves will then point to neighbouring triangles in memory. The triangle indices seen by Bullet will change.
+		void setMortonOrdering(bool enabled);
+
+		///Set the cache where trimeshes and convex hulls are looked up before being built, and stored after. nullptr to use ShapeCache::getDefault()
+		void setShapeCache(ShapeCache* cache);
+
+		///Append geometry from raw memory, without going through Ogre objects. The vertices are transformed, and the indices rebased after the vertices already loaded.
+		/// \param positions : Pointer to the position of the first vertex
+		/// \param stride : Number of bytes between the positions of two consecutive vertices
+		/// \param format : Format of the positions. VET_FLOAT3, VET_FLOAT4, VET_HALF4, VET_DOUBLE3 and VET_DOUBLE4 are supported, other formats throw std::invalid_argument
+		/// \param count : Number of vertices
+		/// \param indices : Pointer to the triangle list indices. If nullptr, the vertices are taken as a triangle list
+		/// \param indexType : Type of the indices, 16 or 32 bits
+		/// \param indexCount : Number of indices
+		/// \param transform : Transform to apply to the vertices
+		void addRawGeometry(const void* positions, size_t stride, Ogre::VertexElementType format, size_t count,
+			const void* indices, Ogre::IndexBufferPacked::IndexType indexType, size_t indexCount,
+			const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY);
 
 	protected:
 
+		///Transform positions read from memory with the current transform, and write them in the vertex buffer from the given index.
+		///This is the vertex kernel used by every loader
+		void writePositions(const unsigned char* data, size_t stride, Ogre::VertexElementType format, size_t count, size_t destination);
+
+		///Rebase indices by the given offset, and write them in the index buffer from the given index.
+		///This is the index kernel used by every loader
+		template<typename T> void writeIndices(const T* indices, size_t count, size_t destination, size_t offset)
+		{
+			auto output = mIndexBuffer.data() + destination;
+			for (auto i = size_t{ 0U }; i < count; ++i)
+				output[i] = static_cast<unsigned>(offset + indices[i]);
+		}
+
+		///Read the geometry whose extraction has been deferred. Called before any access to the vertex or index data.
+		///Bounding shapes (sphere, box, cylinder, capsule) only use mDeferredBounds and never trigger it
+		virtual void extractDeferredGeometry() {}
+
+		///Register a new submesh, and mark the triangles added since the last one as coming from it
+		void tagSubMeshTriangles(const Ogre::String& materialName, Ogre::HlmsDatablock* datablock);
+
+		///Register a new submesh, and mark the triangles from the last tagged one up to endTriangle as coming from it.
+		///Needed when the index buffer was resized for several submeshes at once
+		void tagSubMeshTriangles(const Ogre::String& materialName, Ogre::HlmsDatablock* datablock, size_t endTriangle);
+
+		///Reorder the index buffer along a Morton (Z-order) curve, and the vertex buffer by order of first use
+		void sortTrianglesByMortonCode();
+
 		///Append V2 Vertex data to the vertex buffer
 		void appendV1VertexData(const Ogre::v1::VertexData *vertex_data);
 
@@ -109,11 +222,7 @@ namespace BtOgre
 		template<typename T> void loadV1IndexBuffer(Ogre::v1::HardwareIndexBufferSharedPtr ibuf, const size_t& offset,
 			const size_t& previousSize, const size_t& appendedIndexes)
 		{
-			auto pointerData = static_cast<const T*>(ibuf->lock(Ogre::v1::HardwareBuffer::HBL_READ_ONLY));
-			for (auto i = 0u; i < appendedIndexes; ++i)
-			{
-				mIndexBuffer[previousSize + i] = static_cast<unsigned>(offset + pointerData[i]);
-			}
+			writeIndices(static_cast<const T*>(ibuf->lock(Ogre::v1::HardwareBuffer::HBL_READ_ONLY)), appendedIndexes, previousSize, offset);
 			ibuf->unlock();
 		}
 
@@ -135,11 +244,7 @@ namespace BtOgre
 		template<typename T> void loadV2IndexBuffer(Ogre::AsyncTicketPtr asyncTicket, const size_t& offset,
 			const size_t& perviousSize, const size_t& appendedIndexes)
 		{
-			auto pointerData = static_cast<const T*>(asyncTicket->map());
-			for (auto i = 0; i < appendedIndexes; ++i)
-			{
-				mIndexBuffer[perviousSize + i] = static_cast<unsigned>(offset + pointerData[i]);
-			}
+			writeIndices(static_cast<const T*>(asyncTicket->map()), appendedIndexes, perviousSize, offset);
 			asyncTicket->unmap();
 		}
 
@@ -154,6 +259,12 @@ namespace BtOgre
 		///Index buffer fo the object being processed
 		IndexBuffer		mIndexBuffer;
 
+		///Index of the submesh each triangle of the index buffer comes from
+		std::vector<unsigned short> mTriangleSubMesh;
+
+		///Material of each submesh loaded
+		std::vector<SubMeshMaterial> mSubMeshMaterials;
+
 		///Bounds of the object as a AABB min/max box
 		Ogre::Vector3	mBounds;
 		
@@ -163,6 +274,9 @@ namespace BtOgre
 		///Radius of a sphere that cointains the object bouns
 		Ogre::Real		mBoundRadius;
 
+		///Bounds (already transformed) of the geometry that hasn't been extracted yet
+		Ogre::AxisAlignedBox mDeferredBounds;
+
 		BoneIndex*		mBoneIndex;
 
 		///Transform to apply to every point of the vertex buffer
@@ -170,6 +284,12 @@ namespace BtOgre
 
 		///Scale vector eventually extracted from a parent nodeS
 		Ogre::Vector3	mScale;
+
+		///If true, triangles are sorted in Morton order before creating a trimesh
+		bool			mMortonOrdering;
+
+		///Cache used by this converter, nullptr for the default one
+		ShapeCache*		mShapeCache;
 	};
 
 	///Shape converter for static (non-animated) meshes.
@@ -188,6 +308,9 @@ namespace BtOgre
 		///Create a mesh converter from a V2 Item object
 		StaticMeshToShapeConverter(Ogre::Item* item, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY);
 
+		///Create a mesh converter from the geometry read from a mesh file. Doesn't need a render system
+		StaticMeshToShapeConverter(const MeshFileReader& meshFile, const Ogre::Matrix4 &transform = Ogre::Matrix4::IDENTITY);
+
 		///Default constructor; You can add a mesh/entity later
 		StaticMeshToShapeConverter();
 
@@ -206,8 +329,46 @@ namespace BtOgre
 		///Load an Ogre v2 Mesh
 		void addMesh(const Ogre::Mesh* mesh, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY);
 
+		///Load the geometry read from a mesh file
+		void addMeshFile(const MeshFileReader& meshFile, const Ogre::Matrix4& transform = Ogre::Matrix4::IDENTITY);
+
 	protected:
 
+		///A mesh added to the converter whose buffers are only read when vertex or index data is needed.
+		///Meshes added by pointer have to stay loaded until then
+		struct DeferredMesh
+		{
+			///v2 mesh to read, or nullptr
+			const Ogre::Mesh* mesh;
+
+			///v1 mesh to read, or nullptr
+			const Ogre::v1::Mesh* v1Mesh;
+
+			///Item the v2 mesh comes from, if any. Used to get the datablocks
+			Ogre::Item* item;
+
+			///Entity the v1 mesh comes from, if any. Used to get the datablocks
+			Ogre::v1::Entity* entity;
+
+			///Transform to apply to the vertices
+			Ogre::Matrix4 transform;
+		};
+
+		///Read the buffers of all the deferred meshes
+		void extractDeferredGeometry() override;
+
+		///Add a mesh to the deferred list, or extract it now if it has no usable bounds
+		void deferMesh(const DeferredMesh& deferred, Ogre::AxisAlignedBox bounds);
+
+		///Read the buffers of an Ogre v1 mesh
+		void extractMesh(const Ogre::v1::Mesh* mesh, const Ogre::Matrix4& transform, Ogre::v1::Entity* entity);
+
+		///Read the buffers of an Ogre v2 mesh
+		void extractMesh(const Ogre::Mesh* mesh, const Ogre::Matrix4& transform, Ogre::Item* item);
+
+		///Meshes not extracted yet
+		std::vector<DeferredMesh> mDeferredMeshes;
+
 		///Stored Entity
 		Ogre::v1::Entity*		mEntity;
 
@@ -0,0 +1,87 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreMeshFile.h
+ *
+ *    Description:  Reader for the geometry stored in Ogre .mesh files. Does not create
+ *                  any hardware buffer, and does not need a render system.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <OgreDataStream.h>
+#include <OgreVector3.h>
+
+namespace BtOgre
+{
+	///Geometry of a submesh read from a mesh file
+	struct MeshFileSubMesh
+	{
+		///Name of the material set on the submesh
+		Ogre::String materialName;
+
+		///If true, the indices refer to the shared vertices of the mesh. Always false for v2 meshes
+		bool useSharedVertices;
+
+		///Positions of the submesh own vertices. Empty if using shared vertices
+		std::vector<Ogre::Vector3> vertices;
+
+		///Triangle list indices. Strips and fans are converted to lists
+		std::vector<unsigned int> indices;
+	};
+
+	///Read the collision geometry (positions and triangle indices) of an Ogre .mesh file, straight from the binary data.
+	///Nothing is uploaded to the GPU, so this can be used on a server without any render system.
+	///Both the v1 mesh serializer format and the v2 one (revisions up to "[MeshSerializer_v2.1 R2]") are read, the revision is taken from the file header.
+	///Of a v2 mesh, only the full detail LOD is read
+	class MeshFileReader
+	{
+	public:
+		///Parse the mesh from a file on disk
+		explicit MeshFileReader(const Ogre::String& path);
+
+		///Parse the mesh from an Ogre data stream (e.g. a stream opened by the ResourceGroupManager)
+		explicit MeshFileReader(Ogre::DataStreamPtr stream);
+
+		///Parse the mesh from a memory buffer
+		MeshFileReader(const unsigned char* data, size_t size);
+
+		///Get the version string found in the file header
+		const Ogre::String& getVersion() const;
+
+		///Get the positions of the vertices shared by the submeshes
+		const std::vector<Ogre::Vector3>& getSharedVertices() const;
+
+		///Get the submeshes
+		const std::vector<MeshFileSubMesh>& getSubMeshes() const;
+
+		///Return true if the mesh is linked to a skeleton
+		bool hasSkeleton() const;
+
+	private:
+
+		///Read the whole content of the buffer
+		void parse(const unsigned char* data, size_t size);
+
+		///Version string of the file
+		Ogre::String mVersion;
+
+		///Shared vertex positions
+		std::vector<Ogre::Vector3> mSharedVertices;
+
+		///Submeshes in file order
+		std::vector<MeshFileSubMesh> mSubMeshes;
+
+		///Mesh has a skeleton link
+		bool mHasSkeleton;
+	};
+}
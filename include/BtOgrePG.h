@@ -16,6 +16,10 @@
 
 #pragma once
 
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 #include <btBulletDynamicsCommon.h>
 #include <OgreSceneNode.h>
 #include "BtOgreExtras.h"
@@ -57,6 +61,9 @@ namespace BtOgre
 		///Set the world transform without updating Ogre world
 		void setWorldTransformNoUpdate(const btTransform& in);
 
+		///Move the stored transform by -offset without updating Ogre world. Used by FloatingOrigin
+		virtual void shiftOrigin(const btVector3& offset);
+
 		///Set the node used by this rigid body state
 		void setNode(Ogre::SceneNode* node);
 
@@ -70,5 +77,391 @@ namespace BtOgre
 		btVector3 getOffset() const;
 	};
 
+	class DeferredRigidBodyState;
+
+	///Double buffered node transforms, written by the physics thread and applied to the nodes by the render thread.
+	///Each registered DeferredRigidBodyState has one slot per buffer, the last transform written wins: a late render thread only applies the latest pose of each node.
+	///The buffers are only exchanged under the lock, the nodes are never touched by the physics thread
+	class DeferredTransformQueue
+	{
+	public:
+		///Record the transform to give to the node of a state. Physics thread
+		void push(DeferredRigidBodyState* state, Ogre::SceneNode* node, const Ogre::Vector3& position, const Ogre::Quaternion& orientation);
+
+		///Make the transforms pushed since the last call available to applyPendingTransforms(). Physics thread, after stepSimulation()
+		void publish();
+
+		///Set the published transforms to their nodes. Render thread, while the scene graph isn't being updated (e.g. before renderOneFrame())
+		void applyPendingTransforms();
+
+		///Drop every transform not applied yet. Call it while the physics thread is idle, before destroying nodes that may still have one pending
+		void clear();
+
+		///Register a state, done by its constructor. Call it while the physics thread is idle
+		void addState(DeferredRigidBodyState* state);
+
+		///Unregister a state and drop its pending transform, done by its destructor. Call it while the physics thread is idle
+		void removeState(DeferredRigidBodyState* state);
+
+	private:
+		///Transform to give to a node
+		struct PendingTransform
+		{
+			Ogre::SceneNode* node;
+			Ogre::Vector3 position;
+			Ogre::Quaternion orientation;
+			bool pending;
+		};
+
+		///Registered states, in slot order
+		std::vector<DeferredRigidBodyState*> mStates;
+
+		///Written by push(), only used by the physics thread
+		std::vector<PendingTransform> mWriteBuffer;
+
+		///Published and not applied yet. A publish overwrites the slots the render thread hasn't applied yet
+		std::vector<PendingTransform> mPendingBuffer;
+
+		///Being applied, only used by the render thread
+		std::vector<PendingTransform> mApplyBuffer;
+
+		///Protect mPendingBuffer
+		std::mutex mMutex;
+	};
+
+	///Rigid body state for multithreaded uses: the physics can be stepped on another thread while Ogre renders.
+	///Instead of moving the node, setWorldTransform() pushes the new transform in a DeferredTransformQueue
+	class DeferredRigidBodyState : public RigidBodyState
+	{
+		friend class DeferredTransformQueue;
+
+	protected:
+
+		///Queue the transforms are pushed to
+		DeferredTransformQueue* mQueue;
+
+		///Slot in the queue buffers
+		size_t mQueueIndex;
+
+	public:
+
+		///Create a deferred rigid body state with a specified transform and offset
+		DeferredRigidBodyState(DeferredTransformQueue* queue, Ogre::SceneNode* node, const btTransform& transform, const btTransform& offset = btTransform::getIdentity());
+
+		///Create a simple deferred rigid body state. Reads the transform of the node, so create it on the render thread
+		DeferredRigidBodyState(DeferredTransformQueue* queue, Ogre::SceneNode* node);
+
+		///Unregister from the queue
+		virtual ~DeferredRigidBodyState();
+
+		DeferredRigidBodyState(const DeferredRigidBodyState&) = delete;
+		DeferredRigidBodyState& operator=(const DeferredRigidBodyState&) = delete;
+
+		///Set the world transform, the node will get it at the next DeferredTransformQueue::applyPendingTransforms() after the next publish()
+		void setWorldTransform(const btTransform& in) override;
+	};
+
+	class InterpolatedRigidBodyState;
+
+	///Step a world at a fixed rate, whatever the frame rate, and set the nodes of the InterpolatedRigidBodyState objects
+	///between the last two physics poses, using the time left in the accumulator
+	class FixedStepInterpolator
+	{
+	public:
+		///Step the given world every fixedTimeStep seconds. After maxSubSteps steps in one update, the time left is dropped to catch up
+		FixedStepInterpolator(btDiscreteDynamicsWorld* world, btScalar fixedTimeStep = btScalar(1) / 30, int maxSubSteps = 8);
+
+		///Add the time elapsed since the last frame, run the physics steps due and interpolate the nodes. Return the number of steps done
+		int update(btScalar frameTime);
+
+		///Set the duration of a step
+		void setFixedTimeStep(btScalar fixedTimeStep);
+
+		///Get the duration of a step
+		btScalar getFixedTimeStep() const;
+
+		///Set the maximal number of steps per update
+		void setMaxSubSteps(int maxSubSteps);
+
+		///Get the maximal number of steps per update
+		int getMaxSubSteps() const;
+
+		///Get the fraction of a step left in the accumulator, used as the interpolation factor
+		btScalar getAlpha() const;
+
+		///Get the time spent in the last step, in milliseconds
+		double getLastStepTime() const;
+
+		///Get the time spent in the last update, all steps included, in milliseconds
+		double getLastUpdateTime() const;
+
+		///Get the number of steps done since the creation of the interpolator
+		unsigned long long getStepCount() const;
+
+		///Register a state to interpolate, done by its constructor
+		void addState(InterpolatedRigidBodyState* state);
+
+		///Unregister a state, done by its destructor
+		void removeState(InterpolatedRigidBodyState* state);
+
+	private:
+		///World to step
+		btDiscreteDynamicsWorld* mWorld;
+
+		///Duration of a step
+		btScalar mFixedTimeStep;
+
+		///Maximal number of steps per update
+		int mMaxSubSteps;
+
+		///Time not simulated yet
+		btScalar mAccumulator;
+
+		///Time of the last step
+		double mLastStepTime;
+
+		///Time of the last update
+		double mLastUpdateTime;
+
+		///Number of steps done
+		unsigned long long mStepCount;
+
+		///States to interpolate
+		std::vector<InterpolatedRigidBodyState*> mStates;
+	};
+
+	///Rigid body state that keeps the previous and the current physics poses, and set the node in between when asked by a FixedStepInterpolator.
+	///The interpolator must outlive the states registered to it
+	class InterpolatedRigidBodyState : public RigidBodyState
+	{
+		friend class FixedStepInterpolator;
+
+	protected:
+
+		///Interpolator this state is registered to
+		FixedStepInterpolator* mInterpolator;
+
+		///Physics pose before the last step
+		btTransform mPreviousTransform;
+
+		///Step when mTransform was last set
+		unsigned long long mStep;
+
+		///Position in the interpolator list
+		size_t mInterpolatorIndex;
+
+	public:
+
+		///Create an interpolated rigid body state with a specified transform and offset
+		InterpolatedRigidBodyState(FixedStepInterpolator* interpolator, Ogre::SceneNode* node, const btTransform& transform, const btTransform& offset = btTransform::getIdentity());
+
+		///Create a simple interpolated rigid body state
+		InterpolatedRigidBodyState(FixedStepInterpolator* interpolator, Ogre::SceneNode* node);
+
+		///Unregister from the interpolator
+		virtual ~InterpolatedRigidBodyState();
+
+		InterpolatedRigidBodyState(const InterpolatedRigidBodyState&) = delete;
+		InterpolatedRigidBodyState& operator=(const InterpolatedRigidBodyState&) = delete;
+
+		///Store the new physics pose, the previous one is kept for the interpolation. Doesn't move the node
+		void setWorldTransform(const btTransform& in) override;
+
+		///Move both stored poses by -offset
+		void shiftOrigin(const btVector3& offset) override;
+
+		///Set the node between the previous and the current pose. 0 is the previous pose, 1 the current one.
+		///If the body hasn't been moved by the last step (e.g. it's sleeping), the node is set to the current pose
+		void interpolate(btScalar alpha);
+	};
+
+	class KinematicMotionState;
+
+	///Read the derived transforms of the nodes of every registered KinematicMotionState in one pass.
+	///Call update() after Ogre's scene graph update and before stepping the world: the cached derived transforms are read, no node is forced to update
+	class KinematicBodyDriver
+	{
+	public:
+		///Copy the node transforms to the motion states. Return the number of states updated
+		size_t update();
+
+		///Get the number of states registered
+		size_t getStateCount() const;
+
+		///Register a state, done by its constructor
+		void addState(KinematicMotionState* state);
+
+		///Unregister a state, done by its destructor
+		void removeState(KinematicMotionState* state);
+
+	private:
+		///Registered states
+		std::vector<KinematicMotionState*> mStates;
+	};
+
+	///Motion state of a kinematic body that follows an Ogre node, the counterpart of RigidBodyState.
+	///Bullet reads it at each step, and it is only updated by a KinematicBodyDriver (or by hand with updateFromNode()).
+	///The body should have the CF_KINEMATIC_OBJECT flag and the DISABLE_DEACTIVATION activation state
+	class KinematicMotionState : public btMotionState
+	{
+		friend class KinematicBodyDriver;
+
+	protected:
+
+		///Transform given to Bullet
+		btTransform mTransform;
+
+		///Relative transform between the RigidBody and the pivot of the Ogre Mesh
+		btTransform mCenterOfMassOffset;
+
+		///Node followed
+		Ogre::SceneNode* mNode;
+
+		///Driver updating this state, can be nullptr
+		KinematicBodyDriver* mDriver;
+
+		///Position in the driver list
+		size_t mDriverIndex;
+
+	public:
+
+		///Create a kinematic motion state following a node, registered to the driver if there is one. The node transform is read right away
+		KinematicMotionState(KinematicBodyDriver* driver, Ogre::SceneNode* node, const btTransform& offset = btTransform::getIdentity());
+
+		///Unregister from the driver
+		virtual ~KinematicMotionState();
+
+		KinematicMotionState(const KinematicMotionState&) = delete;
+		KinematicMotionState& operator=(const KinematicMotionState&) = delete;
+
+		///Get the world transform read from the node
+		void getWorldTransform(btTransform& ret) const override;
+
+		///Bullet doesn't move kinematic bodies, nothing to do
+		void setWorldTransform(const btTransform& in) override;
+
+		///Read the cached derived transform of the node. The scene graph must have been updated since the node last moved
+		void updateFromNode();
+
+		///Move the transform given to Bullet by -offset. Used by FloatingOrigin
+		void shiftOrigin(const btVector3& offset);
+
+		///Set the node followed
+		void setNode(Ogre::SceneNode* node);
+
+		///Get the node followed
+		Ogre::SceneNode* getNode() const;
+	};
+
+	///Copy the transforms of many rigid bodies to their nodes in one pass after the step, instead of one virtual motion state call per body.
+	///Sleeping bodies, and bodies that moved less than the epsilons since their node was last written, are skipped,
+	///so the cost scales with the number of moving bodies. Bodies added to it should not have a motion state.
+	///Nodes whose parent is a root scene node are written in local space, the root is expected to stay at the origin.
+	///The dynamic ones are written straight in the SoA transform memory of Ogre, sorted by block, a whole block at a time when possible.
+	///When a body falls asleep its node, and the Items attached to it, are switched to SCENE_STATIC, and back to SCENE_DYNAMIC
+	///when it moves again, so Ogre only updates and culls the active bodies every frame
+	class BodySyncSystem
+	{
+	public:
+		///Create a sync system. Movements shorter than linearEpsilon, and rotations smaller than angularEpsilon (in radians) are ignored
+		BodySyncSystem(btScalar linearEpsilon = btScalar(1e-4), btScalar angularEpsilon = btScalar(1e-4));
+
+		///Make the node follow the body. The node is written at the next synchronize()
+		void addBody(btRigidBody* body, Ogre::SceneNode* node, const btTransform& offset = btTransform::getIdentity());
+
+		///Stop updating the node of a body
+		void removeBody(btRigidBody* body);
+
+		///Write the transforms of the bodies that moved to their nodes. Call it after stepSimulation(). Return the number of nodes written
+		size_t synchronize();
+
+		///Get the number of bodies synchronized
+		size_t getBodyCount() const;
+
+		///Switch the nodes of the sleeping bodies to SCENE_STATIC (the default). If disabled, the nodes are switched back to SCENE_DYNAMIC when written
+		void setStaticSleepingNodes(bool enable);
+
+		///Get the number of nodes currently switched to SCENE_STATIC
+		size_t getStaticNodeCount() const;
+
+		///Move the body transforms the nodes were last written with by -offset, so a shift alone doesn't rewrite every node. Used by FloatingOrigin
+		void shiftOrigin(const btVector3& offset);
+
+	private:
+		///A body and the node following it
+		struct Entry
+		{
+			///Body to read
+			btRigidBody* body;
+
+			///Node to write
+			Ogre::SceneNode* node;
+
+			///Relative transform between the body and the node
+			btTransform offset;
+
+			///Body transform when the node was last written
+			btTransform written;
+
+			///Node never written yet
+			bool force;
+
+			///Parent of the node is a root scene node
+			bool local;
+
+			///Node is currently SCENE_STATIC
+			bool isStatic;
+		};
+
+		///Synchronized bodies, kept contiguous
+		std::vector<Entry> mEntries;
+
+		///Position of each body in mEntries
+		std::unordered_map<const btRigidBody*, size_t> mIndices;
+
+		///Node transform to write in Ogre's SoA transform memory
+		struct SoAWrite
+		{
+			///Block holding the position of the node
+			Ogre::ArrayVector3* position;
+
+			///Block holding the orientation of the node
+			Ogre::ArrayQuaternion* orientation;
+
+			///Lane of the node in the blocks
+			size_t index;
+
+			///Position to write
+			Ogre::Vector3 value;
+
+			///Orientation to write
+			Ogre::Quaternion rotation;
+
+			///Node written
+			Ogre::SceneNode* node;
+		};
+
+		///Write mSoAWrites, a full block at a time when every lane of it moved
+		void writeSoA();
+
+		///Entries to write during this synchronize()
+		std::vector<size_t> mMoved;
+
+		///Transforms to write straight in the SoA memory during this synchronize()
+		std::vector<SoAWrite> mSoAWrites;
+
+		///Squared linear epsilon
+		btScalar mLinearEpsilon2;
+
+		///Squared bound of the basis difference for the angular epsilon
+		btScalar mAngularEpsilon2;
+
+		///Demote the nodes of the sleeping bodies
+		bool mStaticSleepingNodes;
+
+		///Number of static nodes
+		size_t mStaticNodeCount;
+	};
+
 	//Softbody-Ogre connection goes here!
 }
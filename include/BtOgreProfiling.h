@@ -0,0 +1,175 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreProfiling.h
+ *
+ *    Description:  Scoped profiling zones and per frame counters of the BtOgre hot
+ *                  paths. Compiled out unless BTOGRE_PROFILING is defined.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace BtOgre
+{
+	///Instrumented stages
+	enum class ProfileStage : unsigned
+	{
+		///appendV1VertexData(), v1 buffer lock and vertex transform
+		V1VertexData,
+
+		///extractV2SubMeshVertexBuffer(), vertex transform of a mapped v2 buffer
+		V2VertexData,
+
+		///Lock of a v1 buffer, or read request and map of a v2 buffer
+		BufferMapping,
+
+		///Transform of the vertices into the converter's vertex buffer
+		VertexTransform,
+
+		///createTrimesh(), triangle copy and BVH
+		Trimesh,
+
+		///Build of the BVH of a trimesh
+		BvhBuild,
+
+		///RigidBodyState::setWorldTransform()
+		MotionStateSync,
+
+		///LineDrawer::update(), upload of the debug lines
+		DebugLineUpload,
+
+		///PhysicsWorld::step(), one fixed step of the world
+		Simulation,
+
+		Count
+	};
+
+	///Instrumented counters
+	enum class ProfileCounter : unsigned
+	{
+		///Vertices read by the converters
+		VerticesProcessed,
+
+		///Lines uploaded by the debug drawer
+		LinesDrawn,
+
+		///Scene nodes written by the motion states
+		NodesWritten,
+
+		Count
+	};
+
+	///Timings and counters gathered during one frame
+	struct ProfileFrame
+	{
+		///Time spent in each stage, in milliseconds
+		std::array<double, size_t(ProfileStage::Count)> milliseconds;
+
+		///Number of times each stage was entered
+		std::array<std::uint64_t, size_t(ProfileStage::Count)> calls;
+
+		///Value of each counter
+		std::array<std::uint64_t, size_t(ProfileCounter::Count)> counters;
+
+		///Get the time spent in a stage
+		double getMilliseconds(ProfileStage stage) const { return milliseconds[size_t(stage)]; }
+
+		///Get the number of times a stage was entered
+		std::uint64_t getCalls(ProfileStage stage) const { return calls[size_t(stage)]; }
+
+		///Get the value of a counter
+		std::uint64_t getCounter(ProfileCounter counter) const { return counters[size_t(counter)]; }
+	};
+
+	///Collect the timings of the profiling zones. Recording is thread safe and lock free.
+	///Call endFrame() once per frame to close the current frame and push it in the ring.
+	///Nothing is recorded unless the library is built with BTOGRE_PROFILING
+	class Profiler
+	{
+	public:
+		///Function called at the end of each zone, with its duration in milliseconds. Can be called from any thread
+		using Callback = std::function<void(ProfileStage stage, double milliseconds)>;
+
+		///Do not permit to construct a "BtOgre::Profiler" object
+		Profiler() = delete;
+
+		///Set the function called at the end of each zone. Set it before the zones run, nullptr to remove it
+		static void setCallback(Callback callback);
+
+		///Keep the given number of closed frames. 0 (the default) to keep none
+		static void setFrameRingSize(size_t frames);
+
+		///Close the current frame: store it in the ring, and start a new one
+		static void endFrame();
+
+		///Get the frame being recorded
+		static ProfileFrame getCurrentFrame();
+
+		///Get the last closed frame
+		static ProfileFrame getLastFrame();
+
+		///Get the frames in the ring, oldest first
+		static std::vector<ProfileFrame> getFrames();
+
+		///Get a printable name of a stage
+		static const char* getStageName(ProfileStage stage);
+
+		///Get a printable name of a counter
+		static const char* getCounterName(ProfileCounter counter);
+
+		///Add the duration of a zone to the current frame
+		static void record(ProfileStage stage, std::chrono::steady_clock::duration duration);
+
+		///Add to a counter of the current frame
+		static void count(ProfileCounter counter, std::uint64_t amount);
+	};
+
+	///Time the scope it lives in. Use it through BTOGRE_PROFILE_ZONE
+	class ProfileZone
+	{
+	public:
+		explicit ProfileZone(ProfileStage stage) :
+			mStage(stage),
+			mStart(std::chrono::steady_clock::now())
+		{
+		}
+
+		~ProfileZone()
+		{
+			Profiler::record(mStage, std::chrono::steady_clock::now() - mStart);
+		}
+
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator=(const ProfileZone&) = delete;
+
+	private:
+		ProfileStage mStage;
+		std::chrono::steady_clock::time_point mStart;
+	};
+}
+
+#define BTOGRE_PROFILE_CONCAT_IMPL(a, b) a##b
+#define BTOGRE_PROFILE_CONCAT(a, b) BTOGRE_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef BTOGRE_PROFILING
+///Time the rest of the current scope as the given ProfileStage
+#define BTOGRE_PROFILE_ZONE(stage) ::BtOgre::ProfileZone BTOGRE_PROFILE_CONCAT(btOgreProfileZone, __LINE__)(::BtOgre::ProfileStage::stage)
+///Add an amount to the given ProfileCounter
+#define BTOGRE_PROFILE_COUNT(counter, amount) ::BtOgre::Profiler::count(::BtOgre::ProfileCounter::counter, std::uint64_t(amount))
+#else
+#define BTOGRE_PROFILE_ZONE(stage) ((void)0)
+#define BTOGRE_PROFILE_COUNT(counter, amount) ((void)0)
+#endif
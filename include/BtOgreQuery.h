@@ -0,0 +1,132 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreQuery.h
+ *
+ *    Description:  Batches of ray and convex sweep queries run in parallel against
+ *                  a world, with results in Ogre types.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+#include <OgreRay.h>
+#include "BtOgreRegistry.h"
+#include "BtOgreThreading.h"
+
+namespace BtOgre
+{
+	///Result of a query of a QueryBatch
+	struct QueryHit
+	{
+		///Something was hit
+		bool hasHit;
+
+		///Closest hit point, in world space
+		Ogre::Vector3 position;
+
+		///Normal of the surface at the hit point
+		Ogre::Vector3 normal;
+
+		///Fraction of the segment or sweep done before the hit, 1 if nothing was hit
+		Ogre::Real fraction;
+
+		///Object hit
+		const btCollisionObject* object;
+
+		///Handle of the body hit, if the batch has a registry and the body is registered
+		BodyHandle body;
+
+		///Item of the body hit, if the batch has a registry and the body has one
+		Ogre::Item* item;
+	};
+
+	///Batch of ray and convex sweep queries, run across the threads of a TaskPool against a world, between two steps.
+	///Queries only read the world: the broadphase trees of a btDbvtBroadphase are traversed with one stack per task,
+	///and the query and result arrays are kept between batches, so nothing is allocated per query once warmed up.
+	///With another broadphase, or without a pool, the queries run on the calling thread through the world
+	class QueryBatch
+	{
+	public:
+		///Run the queries against the world, on the pool if there is one. The registry, if any, is used to fill QueryHit::body and QueryHit::item
+		QueryBatch(btCollisionWorld* world, TaskPool* pool = nullptr, const BodyRegistry* registry = nullptr);
+
+		///Remove every query and result, the memory is kept for the next batch
+		void clear();
+
+		///Add a ray going up to the given distance. Return the index of its result
+		size_t addRay(const Ogre::Ray& ray, Ogre::Real distance, const btCollisionObject* ignored = nullptr,
+			int group = btBroadphaseProxy::DefaultFilter, int mask = btBroadphaseProxy::AllFilter);
+
+		///Add a ray between two points. Return the index of its result
+		size_t addSegment(const Ogre::Vector3& from, const Ogre::Vector3& to, const btCollisionObject* ignored = nullptr,
+			int group = btBroadphaseProxy::DefaultFilter, int mask = btBroadphaseProxy::AllFilter);
+
+		///Add a sweep of a convex shape between two points. The shape must stay alive until execute() returns. Return the index of its result
+		size_t addSweep(const btConvexShape* shape, const Ogre::Vector3& from, const Ogre::Vector3& to,
+			const Ogre::Quaternion& orientation = Ogre::Quaternion::IDENTITY, const btCollisionObject* ignored = nullptr,
+			int group = btBroadphaseProxy::DefaultFilter, int mask = btBroadphaseProxy::AllFilter);
+
+		///Get the number of queries
+		size_t getQueryCount() const;
+
+		///Run every query. The world must not be modified meanwhile
+		void execute();
+
+		///Get the results of the last execute(), in the order the queries were added
+		const std::vector<QueryHit>& getResults() const;
+
+	private:
+		///A ray or a sweep
+		struct Query
+		{
+			///Shape swept, nullptr for a ray
+			const btConvexShape* shape;
+			btVector3 from;
+			btVector3 to;
+			btQuaternion orientation;
+			const btCollisionObject* ignored;
+			int group;
+			int mask;
+		};
+
+		///Run a range of queries, with the given traversal stack
+		void run(size_t begin, size_t end, btAlignedObjectArray<const btDbvtNode*>& stack);
+
+		///Run one query by traversing the broadphase trees
+		void runQuery(const Query& query, QueryHit& hit, btAlignedObjectArray<const btDbvtNode*>& stack) const;
+
+		///Run one query through the world, not thread safe
+		void runQueryOnWorld(const Query& query, QueryHit& hit) const;
+
+		///Fill the body and Item of a hit
+		void mapHit(QueryHit& hit) const;
+
+		///World queried
+		btCollisionWorld* mWorld;
+
+		///Pool running the queries
+		TaskPool* mPool;
+
+		///Registry mapping the objects hit
+		const BodyRegistry* mRegistry;
+
+		///Queries of the batch
+		std::vector<Query> mQueries;
+
+		///Results of the batch
+		std::vector<QueryHit> mResults;
+
+		///Traversal stack of each task
+		std::vector<btAlignedObjectArray<const btDbvtNode*>> mStacks;
+	};
+}
@@ -0,0 +1,169 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreRegistry.h
+ *
+ *    Description:  Registry of the bodies of a world, with the Ogre nodes and Items
+ *                  they drive, addressed by generational handles.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+#include <OgreItem.h>
+#include <OgreSceneNode.h>
+#include "BtOgrePG.h"
+
+namespace BtOgre
+{
+	///Handle of a body in a BodyRegistry. It stays valid until the body is destroyed, and is never reused for another body
+	struct BodyHandle
+	{
+		///Index of an invalid handle
+		enum : Ogre::uint32 { INVALID_INDEX = 0xFFFFFFFF };
+
+		///Slot of the body in the registry
+		Ogre::uint32 index;
+
+		///Number of times the slot was reused when the body was registered
+		Ogre::uint32 generation;
+
+		///Create an invalid handle
+		BodyHandle() : index(INVALID_INDEX), generation(0) {}
+
+		///Create a handle
+		BodyHandle(Ogre::uint32 slot, Ogre::uint32 gen) : index(slot), generation(gen) {}
+
+		///Return false for a default constructed handle. A valid looking handle may still point to a destroyed body, check it with BodyRegistry::isValid()
+		explicit operator bool() const { return index != INVALID_INDEX; }
+
+		bool operator==(const BodyHandle& other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const BodyHandle& other) const { return !(*this == other); }
+	};
+
+	///Print a handle, needed to store it in an Ogre::Any
+	inline std::ostream& operator<<(std::ostream& stream, const BodyHandle& handle)
+	{
+		return stream << "BodyHandle(" << handle.index << ", " << handle.generation << ")";
+	}
+
+	///Owner of the rigid bodies of a world, with their motion state, shape, node and Item, kept in dense arrays.
+	///The body gets the slot of its handle as user index, and the node and the Item get the handle as user Any:
+	///going from a ray or contact result, a node or an Item back to the body and its other objects is an array access.
+	///Destroying a body (or the registry) removes it from the world and deletes its motion state, and its shape if owned
+	///(child shapes of compounds and triangle mesh interfaces included)
+	class BodyRegistry
+	{
+	public:
+		///Register the bodies of the given world
+		explicit BodyRegistry(btDynamicsWorld* world);
+
+		///Destroy every body still registered. The nodes and Items are left to their scene manager
+		~BodyRegistry();
+
+		BodyRegistry(const BodyRegistry&) = delete;
+		BodyRegistry& operator=(const BodyRegistry&) = delete;
+
+		///Create a body following the node (with a RigidBodyState) and add it to the world. Set ownsShape to false for shapes shared between bodies
+		BodyHandle create(btScalar mass, btCollisionShape* shape, Ogre::SceneNode* node, Ogre::Item* item = nullptr, bool ownsShape = true);
+
+		///Register an existing body, added to the world if it isn't already. The registry owns it and its motion state from now on
+		BodyHandle add(btRigidBody* body, Ogre::SceneNode* node = nullptr, Ogre::Item* item = nullptr, bool ownsShape = true);
+
+		///Remove a body from the world and delete it. If destroySceneObjects is true, the Item and the node are destroyed too
+		void destroy(BodyHandle handle, bool destroySceneObjects = false);
+
+		///Return true if the handle points to a registered body
+		bool isValid(BodyHandle handle) const;
+
+		///Get the body of a handle, nullptr if the handle isn't valid
+		btRigidBody* getBody(BodyHandle handle) const;
+
+		///Get the motion state of a handle, nullptr if the handle isn't valid or the body doesn't have a RigidBodyState
+		RigidBodyState* getMotionState(BodyHandle handle) const;
+
+		///Get the node of a handle, nullptr if the handle isn't valid or the body doesn't have a node
+		Ogre::SceneNode* getNode(BodyHandle handle) const;
+
+		///Get the Item of a handle, nullptr if the handle isn't valid or the body doesn't have an Item
+		Ogre::Item* getItem(BodyHandle handle) const;
+
+		///Get the handle of a body, e.g. the collision object of a ray or contact result. Invalid if it isn't registered
+		BodyHandle getHandle(const btCollisionObject* object) const;
+
+		///Get the handle of the body a node follows. Invalid if there is none
+		BodyHandle getHandle(const Ogre::Node* node) const;
+
+		///Get the handle of the body of an Item. Invalid if there is none
+		BodyHandle getHandle(const Ogre::MovableObject* item) const;
+
+		///Get the number of bodies
+		size_t getBodyCount() const;
+
+		///Get the bodies, in the same order as getNodes() and getItems()
+		const std::vector<btRigidBody*>& getBodies() const;
+
+		///Get the nodes of the bodies
+		const std::vector<Ogre::SceneNode*>& getNodes() const;
+
+		///Get the Items of the bodies
+		const std::vector<Ogre::Item*>& getItems() const;
+
+		///Delete a shape, its children if it's a compound, and its mesh interface if it's a triangle mesh
+		static void deleteShape(btCollisionShape* shape);
+
+	private:
+		///Slot a handle points to
+		struct Slot
+		{
+			///Incremented when the body is destroyed
+			Ogre::uint32 generation;
+
+			///Position in the dense arrays, or next free slot when free
+			Ogre::uint32 dense;
+		};
+
+		///Get the position of a valid handle in the dense arrays, or INVALID_INDEX
+		Ogre::uint32 getDenseIndex(BodyHandle handle) const;
+
+		///Read a handle from the user Any of a node or an Item
+		BodyHandle readHandle(const Ogre::UserObjectBindings& bindings) const;
+
+		///World of the bodies
+		btDynamicsWorld* mWorld;
+
+		///Slots of the handles
+		std::vector<Slot> mSlots;
+
+		///First free slot, or INVALID_INDEX
+		Ogre::uint32 mFreeSlot;
+
+		///Bodies
+		std::vector<btRigidBody*> mBodies;
+
+		///Motion states, if they are RigidBodyStates
+		std::vector<RigidBodyState*> mStates;
+
+		///Nodes
+		std::vector<Ogre::SceneNode*> mNodes;
+
+		///Items
+		std::vector<Ogre::Item*> mItems;
+
+		///The shape of the body is owned
+		std::vector<bool> mOwnsShape;
+
+		///Slot of each body
+		std::vector<Ogre::uint32> mDenseToSlot;
+	};
+}
@@ -0,0 +1,105 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreShapeCache.h
+ *
+ *    Description:  On-disk cache of the collision shapes built by the converters.
+ *                  Trimesh entries are memory mapped and used in place.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+#include <OgrePrerequisites.h>
+#include <OgreVector3.h>
+
+namespace BtOgre
+{
+	///Mesh interface over the vertices and indices of a trimesh cache entry mapped in memory.
+	///It owns the memory (and the BVH stored in it), which is released when the interface is deleted
+	class CachedTriangleMesh : public btTriangleIndexVertexArray
+	{
+	public:
+		///Take ownership of a mapped entry, and point the mesh at the vertices and indices it contains
+		CachedTriangleMesh(void* data, size_t size, const btIndexedMesh& mesh);
+
+		///Unmap the entry
+		virtual ~CachedTriangleMesh();
+
+		CachedTriangleMesh(const CachedTriangleMesh&) = delete;
+		CachedTriangleMesh& operator=(const CachedTriangleMesh&) = delete;
+
+	private:
+
+		///Start of the entry in memory
+		void* mData;
+
+		///Size of the entry
+		size_t mSize;
+	};
+
+	///Cache of the collision shapes built by the converters, stored as one file per shape in a directory.
+	///Entries are looked up by a hash of the extracted geometry and of the shape parameters, so changing the mesh invalidates them.
+	///Trimesh entries contain the quantized BVH, and are memory mapped: the vertices, the indices and the BVH nodes are used in place.
+	///Set it on a converter with VertexIndexToShape::setShapeCache(), or for every converter with ShapeCache::setDefault()
+	class ShapeCache
+	{
+	public:
+		///Kind of shape an entry contains
+		enum ShapeKind : Ogre::uint32
+		{
+			TRIMESH = 1,
+			CONVEX = 2
+		};
+
+		///Use the given directory to store the entries. It is created if it doesn't exist
+		explicit ShapeCache(const Ogre::String& directory);
+
+		///Get the directory where the entries are stored
+		const Ogre::String& getDirectory() const;
+
+		///Hash geometry and shape parameters into the key of an entry
+		static Ogre::uint64 computeKey(ShapeKind kind, const Ogre::Vector3* vertices, size_t vertexCount,
+			const unsigned int* indices, size_t indexCount, const Ogre::Vector3& scale);
+
+		///Load a trimesh entry. Return nullptr on a cache miss. The mesh interface of the shape is a CachedTriangleMesh, delete it as usual
+		btBvhTriangleMeshShape* loadTrimesh(Ogre::uint64 key, size_t vertexCount, size_t indexCount, const btVector3& scale) const;
+
+		///Write a trimesh entry with the geometry and the BVH of a shape built from it
+		void storeTrimesh(Ogre::uint64 key, const Ogre::Vector3* vertices, size_t vertexCount,
+			const unsigned int* indices, size_t indexCount, btBvhTriangleMeshShape* shape) const;
+
+		///Load a convex hull entry. Return nullptr on a cache miss
+		btConvexHullShape* loadConvex(Ogre::uint64 key) const;
+
+		///Write a convex hull entry and return a shape made of what was written. Only the points that are vertices of the hull are kept, so the shape is the same as the ones loaded from the entry later
+		btConvexHullShape* storeConvex(Ogre::uint64 key, const Ogre::Vector3* points, size_t pointCount) const;
+
+		///Set the cache used by the converters that don't have one of their own. nullptr to disable it. The cache isn't owned
+		static void setDefault(ShapeCache* cache);
+
+		///Get the cache used by the converters that don't have one of their own
+		static ShapeCache* getDefault();
+
+	private:
+
+		///Path of the file of an entry
+		Ogre::String getEntryPath(Ogre::uint64 key, ShapeKind kind) const;
+
+		///Write an entry to a temporary file, then move it in place, so a reader never sees a partial entry
+		void writeEntry(const Ogre::String& path, const void* data, size_t size) const;
+
+		///Directory of the entries
+		Ogre::String mDirectory;
+
+		///Cache used by default
+		static ShapeCache* sDefault;
+	};
+}
@@ -0,0 +1,446 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreThreading.h
+ *
+ *    Description:  Threading helpers of BtOgre: Bullet's multithreaded world on the
+ *                  worker threads of an Ogre SceneManager (needs Bullet built with
+ *                  BT_THREADSAFE), physics running on a dedicated thread, and many
+ *                  independent worlds stepped in parallel.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+#include <LinearMath/btThreads.h>
+#include <OgreSceneManager.h>
+#include <OgreSceneNode.h>
+#include <Threading/OgreUniformScalableTask.h>
+#include "BtOgrePG.h"
+
+namespace BtOgre
+{
+	///Lock free exchange of a value between one writer and one reader thread. The reader always gets the last complete value,
+	///and neither side ever waits for the other
+	template <typename T> class TripleBuffer
+	{
+	public:
+		TripleBuffer() :
+			mMiddle(1),
+			mWrite(0),
+			mRead(2)
+		{
+		}
+
+		///Get the value to fill, writer side
+		T& getWriteBuffer() { return mBuffers[mWrite]; }
+
+		///Make the filled value available to the reader, writer side
+		void publish()
+		{
+			mWrite = mMiddle.exchange(mWrite | FRESH, std::memory_order_acq_rel) & INDEX;
+		}
+
+		///Pick the last published value if there is a new one, reader side. Return true if there was
+		bool update()
+		{
+			if (!(mMiddle.load(std::memory_order_relaxed) & FRESH)) return false;
+			mRead = mMiddle.exchange(mRead, std::memory_order_acq_rel) & INDEX;
+			return true;
+		}
+
+		///Get the value picked by the last update(), reader side
+		const T& getReadBuffer() const { return mBuffers[mRead]; }
+
+	private:
+		///Bits of mMiddle
+		enum : unsigned { INDEX = 3, FRESH = 4 };
+
+		///The three values
+		T mBuffers[3];
+
+		///Index of the value in between, and whether it's newer than the reader's
+		std::atomic<unsigned> mMiddle;
+
+		///Index of the writer's value
+		unsigned mWrite;
+
+		///Index of the reader's value
+		unsigned mRead;
+	};
+
+	///Lock free queue with any number of producer threads and one consumer thread
+	template <typename T> class MpscQueue
+	{
+	public:
+		MpscQueue() :
+			mHead(new Node),
+			mTail(mHead.load())
+		{
+		}
+
+		~MpscQueue()
+		{
+			T value;
+			while (pop(value));
+			delete mTail;
+		}
+
+		MpscQueue(const MpscQueue&) = delete;
+		MpscQueue& operator=(const MpscQueue&) = delete;
+
+		///Add a value, from any thread
+		void push(T value)
+		{
+			auto node = new Node;
+			node->value = std::move(value);
+			const auto previous = mHead.exchange(node, std::memory_order_acq_rel);
+			previous->next.store(node, std::memory_order_release);
+		}
+
+		///Take the oldest value, consumer side. Return false if the queue is empty
+		bool pop(T& value)
+		{
+			const auto next = mTail->next.load(std::memory_order_acquire);
+			if (!next) return false;
+
+			value = std::move(next->value);
+			delete mTail;
+			mTail = next;
+			return true;
+		}
+
+	private:
+		///Link of the queue
+		struct Node
+		{
+			std::atomic<Node*> next{ nullptr };
+			T value;
+		};
+
+		///Last pushed node
+		std::atomic<Node*> mHead;
+
+		///Node before the oldest value
+		Node* mTail;
+	};
+
+	///Run a world on its own thread, stepped at a fixed rate, decoupled from the render loop.
+	///After each step the transforms of the bodies added with addBody() are published as a snapshot, through a TripleBuffer.
+	///The render thread applies the latest complete snapshot with applySnapshot(), and never waits for the physics thread.
+	///Everything touching the world (adding bodies, impulses...) goes through commands, queued from any thread and run by the physics thread before each step
+	class PhysicsThread
+	{
+	public:
+		///Command run on the physics thread
+		using Command = std::function<void(btDiscreteDynamicsWorld* world)>;
+
+		///Step the world every fixedTimeStep seconds once started. The world must not be touched by other threads while running
+		PhysicsThread(btDiscreteDynamicsWorld* world, btScalar fixedTimeStep = btScalar(1) / 60);
+
+		///Stop the thread
+		~PhysicsThread();
+
+		PhysicsThread(const PhysicsThread&) = delete;
+		PhysicsThread& operator=(const PhysicsThread&) = delete;
+
+		///Start stepping the world
+		void start();
+
+		///Run the queued commands and stop stepping the world. The world can be used by the calling thread afterwards
+		void stop();
+
+		///Return true if the thread is running
+		bool isRunning() const;
+
+		///Queue a command for the physics thread, from any thread
+		void post(Command command);
+
+		///Add a body to the world and make the node follow it, through the snapshots only.
+		///The body must have no motion state, or one that doesn't touch a node: a RigidBodyState would write to the node from the physics thread
+		void addBody(btRigidBody* body, Ogre::SceneNode* node, const btTransform& offset = btTransform::getIdentity());
+
+		///Remove a body from the world. onRemoved is then called by applySnapshot() on the render thread, once no snapshot can refer to the node anymore:
+		///this is where the body, its motion state and the node can be destroyed
+		void removeBody(btRigidBody* body, std::function<void()> onRemoved = nullptr);
+
+		///Apply an impulse to a body, at a position relative to its center of mass
+		void applyImpulse(btRigidBody* body, const btVector3& impulse, const btVector3& relativePosition = btVector3(0, 0, 0));
+
+		///Apply the latest snapshot to the nodes if there is a new one, then run the callbacks of the removed bodies. Call it from the render thread.
+		///Return true if a new snapshot was applied
+		bool applySnapshot();
+
+		///Get the step of the last snapshot applied
+		unsigned long long getSnapshotStep() const;
+
+		///Get the time spent in the last step, in milliseconds
+		double getLastStepTime() const;
+
+	private:
+		///Transform of a node at the end of a step
+		struct NodeTransform
+		{
+			Ogre::SceneNode* node;
+			Ogre::Vector3 position;
+			Ogre::Quaternion orientation;
+		};
+
+		///Transforms of all the nodes at the end of a step
+		struct Snapshot
+		{
+			unsigned long long step{ 0 };
+			std::vector<NodeTransform> transforms;
+		};
+
+		///A body and the node following it, physics thread side
+		struct Entry
+		{
+			btRigidBody* body;
+			Ogre::SceneNode* node;
+			btTransform offset;
+		};
+
+		///Loop of the physics thread
+		void run();
+
+		///Run the queued commands, physics thread side
+		void runCommands();
+
+		///Fill and publish a snapshot, physics thread side
+		void publishSnapshot();
+
+		///World stepped
+		btDiscreteDynamicsWorld* mWorld;
+
+		///Duration of a step
+		btScalar mFixedTimeStep;
+
+		///Physics thread
+		std::thread mThread;
+
+		///The thread is asked to run
+		std::atomic<bool> mRunning;
+
+		///Commands from any thread to the physics thread
+		MpscQueue<Command> mCommands;
+
+		///Callbacks from the physics thread to the render thread
+		MpscQueue<std::function<void()>> mRemovedCallbacks;
+
+		///Callbacks of the bodies removed during this step, physics thread side
+		std::vector<std::function<void()>> mPendingCallbacks;
+
+		///Snapshots from the physics thread to the render thread
+		TripleBuffer<Snapshot> mSnapshots;
+
+		///Bodies followed by nodes, physics thread side
+		std::vector<Entry> mEntries;
+
+		///Number of steps done, physics thread side
+		unsigned long long mStepCount;
+
+		///Time of the last step, in milliseconds
+		std::atomic<double> mLastStepTime;
+
+		///Step of the last snapshot applied, render thread side
+		unsigned long long mSnapshotStep;
+	};
+
+	///Pool of worker threads running batches of tasks. Each thread has its own queue, and steals from the others when it's empty,
+	///so batches of uneven tasks stay balanced. The thread calling run() works on the batch too
+	class TaskPool
+	{
+	public:
+		///Start the given number of worker threads, in addition to the calling thread. By default one less than the number of cores
+		explicit TaskPool(size_t threads = std::max(1U, std::thread::hardware_concurrency()) - 1);
+
+		///Stop the worker threads
+		~TaskPool();
+
+		TaskPool(const TaskPool&) = delete;
+		TaskPool& operator=(const TaskPool&) = delete;
+
+		///Get the number of threads working on a batch, the calling thread included
+		size_t getThreadCount() const;
+
+		///Run task(i) for every i in [0, count), and return once they are all done. The first exception thrown by a task is rethrown here
+		void run(size_t count, const std::function<void(size_t)>& task);
+
+	private:
+		///Tasks of one thread
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<size_t> tasks;
+		};
+
+		///Loop of a worker thread
+		void work(size_t queue);
+
+		///Run one task, from the given queue or stolen from another one. Return false if there was none left
+		bool runOne(size_t queue);
+
+		///Worker threads
+		std::vector<std::thread> mThreads;
+
+		///One queue per worker thread, the last one for the calling thread
+		std::vector<std::unique_ptr<Queue>> mQueues;
+
+		///Task of the current batch
+		const std::function<void(size_t)>* mTask;
+
+		///Tasks of the current batch not done yet
+		std::atomic<size_t> mRemaining;
+
+		///First exception thrown by the current batch
+		std::exception_ptr mException;
+
+		///Protect the batch state and the conditions
+		std::mutex mMutex;
+
+		///Signaled when a batch starts, or the pool stops
+		std::condition_variable mStart;
+
+		///Signaled when a batch is done
+		std::condition_variable mDone;
+
+		///Number of batches started
+		unsigned long long mBatch;
+
+		///The pool is stopping
+		bool mStop;
+
+		///Only one batch at a time
+		std::mutex mRunMutex;
+	};
+
+	///Independent worlds (e.g. match instances, dungeon zones) stepped concurrently on a TaskPool.
+	///Each world can have a BodySyncSystem writing the nodes of its own scene manager, run by the same thread right after its step.
+	///Worlds must not share bodies, shapes with mutable state, or scene managers, and the scene managers must not be updated during step().
+	///Bullet older than 2.87 has to be built with BT_NO_PROFILE, as its profiler isn't thread safe
+	class WorldGroup
+	{
+	public:
+		///Step the worlds on the given pool
+		explicit WorldGroup(TaskPool* pool);
+
+		///Add a world, and the sync system of its nodes if there is one
+		void addWorld(btDynamicsWorld* world, BodySyncSystem* sync = nullptr);
+
+		///Remove a world
+		void removeWorld(btDynamicsWorld* world);
+
+		///Get the number of worlds
+		size_t getWorldCount() const;
+
+		///Step every world with the given parameters (the ones of btDynamicsWorld::stepSimulation), then synchronize its nodes
+		void step(btScalar timeStep, int maxSubSteps = 1, btScalar fixedTimeStep = btScalar(1) / 60);
+
+		///Get the time spent stepping and synchronizing a world during the last step(), in milliseconds
+		double getLastStepTime(btDynamicsWorld* world) const;
+
+	private:
+		///A world and its sync system
+		struct Member
+		{
+			btDynamicsWorld* world;
+			BodySyncSystem* sync;
+			double lastStepTime;
+		};
+
+		///Pool running the steps
+		TaskPool* mPool;
+
+		///Worlds of the group
+		std::vector<Member> mMembers;
+	};
+
+#if BT_THREADSAFE
+	///Bullet task scheduler running the parallel loops on the worker threads of an Ogre SceneManager, so Ogre and Bullet share one thread pool.
+	///The loops are run with SceneManager::executeUserScalableTask(), so the world has to be stepped from the thread that updates the scene.
+	///Set it with btSetTaskScheduler(), PhysicsWorld does it when given a SceneManager.
+	///Like Bullet's own schedulers, the thread count includes the calling thread (Bullet's thread index 0), so it is the number of workers + 1
+	class OgreTaskScheduler : public btITaskScheduler, public Ogre::UniformScalableTask
+	{
+	public:
+		///Use the worker threads of the given scene manager
+		explicit OgreTaskScheduler(Ogre::SceneManager* sceneManager);
+
+		///Get the number of worker threads of the scene manager, plus the calling thread
+		int getMaxNumThreads() const override;
+
+		///Get the number of threads used, the calling thread included
+		int getNumThreads() const override;
+
+		///Set the number of threads used, the calling thread included, between 1 and getMaxNumThreads(). With 1, the loops run on the calling thread
+		void setNumThreads(int numThreads) override;
+
+		///Split the range in chunks of grainSize, and run them on the worker threads
+		void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body) override;
+
+#if BT_BULLET_VERSION >= 288
+		///Split the range in chunks of grainSize, run them on the worker threads, and sum the results
+		btScalar parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body) override;
+#endif
+
+		///Run chunks of the current loop until there is none left. Called by each worker thread
+		void execute(size_t threadId, size_t numThreads) override;
+
+	private:
+		///Run the current loop on the workers, or on the calling thread if no worker is used
+		void run(int iBegin, int iEnd, int grainSize);
+
+		///Run chunks of the current loop until there is none left, summing in the given slot of mSums
+		void runChunks(size_t slot);
+
+		///Scene manager owning the threads
+		Ogre::SceneManager* mSceneManager;
+
+		///Number of threads used, the calling thread included
+		int mNumThreads;
+
+		///A loop is running
+		std::atomic<bool> mRunning;
+
+		///Start of the next chunk
+		std::atomic<int> mNext;
+
+		///End of the loop
+		int mEnd;
+
+		///Size of a chunk
+		int mGrainSize;
+
+		///Body of the current for loop
+		const btIParallelForBody* mForBody;
+
+#if BT_BULLET_VERSION >= 288
+		///Body of the current sum loop
+		const btIParallelSumBody* mSumBody;
+#endif
+
+		///Sum of the chunks run by each worker, indexed by Ogre's thread id. The last slot is for the calling thread
+		std::vector<btScalar> mSums;
+	};
+#endif
+}
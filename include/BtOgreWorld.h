@@ -0,0 +1,178 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreWorld.h
+ *
+ *    Description:  World level helpers of BtOgre: a physics world owning the Bullet
+ *                  objects and stepping at a fixed rate, and shifting the origin of
+ *                  both the Ogre scene and the Bullet world.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/BroadphaseCollision/btAxisSweep3.h>
+#include <OgreSceneManager.h>
+#include "BtOgreThreading.h"
+
+namespace BtOgre
+{
+	class BodySyncSystem;
+	class FixedStepInterpolator;
+
+	///Bullet dynamics world with the objects it needs (broadphase, dispatcher, solver), stepped at a fixed rate by its FixedStepInterpolator.
+	///Give that interpolator to InterpolatedRigidBodyState to get the nodes set between the last two physics poses at each step().
+	///The world is unbounded and uses a dynamic AABB tree, unless it's given its bounds, where a sweep and prune broadphase is used.
+	///The bodies, shapes and motion states added to the world are not owned, remove and delete them before the PhysicsWorld.
+	///Given a SceneManager, and if Bullet is built with BT_THREADSAFE, the world is a btDiscreteDynamicsWorldMt with parallel
+	///narrowphase and solver, running on the worker threads of the scene manager. It then has to be stepped from the thread updating the scene
+	class PhysicsWorld
+	{
+	public:
+		///Create an unbounded world, with a btDbvtBroadphase
+		explicit PhysicsWorld(const btVector3& gravity = { 0, btScalar(-9.81), 0 }, Ogre::SceneManager* workers = nullptr);
+
+		///Create a world that fits in the given bounds, with a btAxisSweep3 (bt32BitAxisSweep3 beyond 32766 objects).
+		///Objects leaving the bounds still collide, but slowly. The bounds are fixed, so this world can't be used with a FloatingOrigin
+		PhysicsWorld(const Ogre::AxisAlignedBox& bounds, unsigned int maxObjects = 16384, const btVector3& gravity = { 0, btScalar(-9.81), 0 }, Ogre::SceneManager* workers = nullptr);
+
+		///Delete the world and the objects it owns
+		virtual ~PhysicsWorld();
+
+		PhysicsWorld(const PhysicsWorld&) = delete;
+		PhysicsWorld& operator=(const PhysicsWorld&) = delete;
+
+		///Get the bounds of everything attached to the scene graph, grown by the margin. Pass them to the bounded constructor
+		static Ogre::AxisAlignedBox getSceneBounds(Ogre::SceneManager* sceneManager, Ogre::Real margin = 0);
+
+		///Add the time elapsed since the last frame, run the fixed steps due, at most the sub step budget, and interpolate the nodes.
+		///Beyond the budget the time left is dropped, the simulation slows down instead of falling further behind. Return the number of steps done
+		int step(btScalar frameTime);
+
+		///Get the interpolator that steps the world
+		FixedStepInterpolator* getInterpolator() const;
+
+		///Set the duration of a step, 1/60 second by default
+		void setFixedTimeStep(btScalar fixedTimeStep);
+
+		///Get the duration of a step
+		btScalar getFixedTimeStep() const;
+
+		///Set the maximal number of steps per call to step(), 4 by default
+		void setMaxSubSteps(int maxSubSteps);
+
+		///Get the maximal number of steps per call to step()
+		int getMaxSubSteps() const;
+
+		///Get the fraction of a step left to simulate
+		btScalar getAlpha() const;
+
+		///Get the time spent in the last step, in milliseconds
+		double getLastStepTime() const;
+
+		///Get the time spent in the last call to step(), all steps included, in milliseconds
+		double getLastUpdateTime() const;
+
+		///Get the number of steps done since the creation of the world
+		unsigned long long getStepCount() const;
+
+		///Get the dynamics world
+		btDiscreteDynamicsWorld* getWorld() const;
+
+		///Get the broadphase
+		btBroadphaseInterface* getBroadphase() const;
+
+		///Get the collision dispatcher
+		btCollisionDispatcher* getDispatcher() const;
+
+		///Get the constraint solver
+		btConstraintSolver* getSolver() const;
+
+		///Return true if the world runs on worker threads
+		bool isMultithreaded() const;
+
+	protected:
+		///Create the dispatcher, solver and world on the broadphase. Multithreaded if given a scene manager and supported
+		void createWorld(const btVector3& gravity, Ogre::SceneManager* workers);
+
+		///Collision configuration
+		btDefaultCollisionConfiguration* mCollisionConfig;
+
+		///Broadphase
+		btBroadphaseInterface* mBroadphase;
+
+		///Dispatcher
+		btCollisionDispatcher* mDispatcher;
+
+		///Solver
+		btConstraintSolver* mSolver;
+
+		///Dynamics world
+		btDiscreteDynamicsWorld* mWorld;
+
+		///Solver used by the solver pool to solve the islands in parallel, if multithreaded
+		btConstraintSolver* mSolverMt;
+
+		///Scheduler running on the workers, if multithreaded
+		btITaskScheduler* mTaskScheduler;
+
+		///Fixed rate stepping of the world
+		FixedStepInterpolator* mInterpolator;
+	};
+
+	///Keep the simulated area close to the origin in large worlds, so single precision Bullet and Ogre stay accurate.
+	///A shift moves the Ogre scene and every body of the Bullet world by the same amount, in one pass.
+	///The total shift is kept in double precision to convert local positions back to world positions.
+	///The broadphase of the world must not have fixed bounds: a btAxisSweep3 (a bounded PhysicsWorld) would end up clamping the shifted bodies
+	class FloatingOrigin
+	{
+	public:
+		///Shift the given world and scene together. Throw if the world uses a btAxisSweep3 or bt32BitAxisSweep3 broadphase
+		FloatingOrigin(btDynamicsWorld* world, Ogre::SceneManager* sceneManager);
+
+		///Rebase the write cache of a BodySyncSystem at each shift. The sync system isn't owned
+		void addSyncSystem(BodySyncSystem* syncSystem);
+
+		///Stop rebasing a BodySyncSystem
+		void removeSyncSystem(BodySyncSystem* syncSystem);
+
+		///Make the given point the new origin: the scene and the bodies are moved by -offset.
+		///The collision objects, their broadphase proxies, the transforms stored in RigidBodyState and KinematicMotionState, and the added BodySyncSystem caches are rebased.
+		///Other motion states are left alone. Apply the pending transforms of a DeferredTransformQueue before shifting
+		void shift(const btVector3& offset);
+
+		///Shift the origin to the given position (e.g. the camera's) if it is further than the threshold from it. Return true if it did
+		bool recenter(const Ogre::Vector3& position, Ogre::Real threshold);
+
+		///Get the world position of the current origin
+		void getOrigin(double& x, double& y, double& z) const;
+
+		///Convert a position relative to the current origin to a world position
+		void toWorld(const Ogre::Vector3& local, double& x, double& y, double& z) const;
+
+		///Convert a world position to a position relative to the current origin
+		Ogre::Vector3 toLocal(double x, double y, double z) const;
+
+	private:
+		///Shifted world
+		btDynamicsWorld* mWorld;
+
+		///Shifted scene
+		Ogre::SceneManager* mSceneManager;
+
+		///Sync systems to rebase
+		std::vector<BodySyncSystem*> mSyncSystems;
+
+		///World position of the origin
+		double mOrigin[3];
+	};
+}
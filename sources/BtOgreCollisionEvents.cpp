@@ -0,0 +1,178 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreCollisionEvents.cpp
+ *
+ *    Description:  BtOgre collision event stream implementation.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreCollisionEvents.h"
+
+#include <algorithm>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+CollisionEventStream::CollisionEventStream(btCollisionWorld* world, const BodyRegistry* registry, size_t capacity) :
+	mWorld(world),
+	mRegistry(registry),
+	mEvents(std::max<size_t>(1, capacity)),
+	mHead(0),
+	mCount(0),
+	mDropped(0),
+	mReportPersist(true)
+{
+}
+
+std::uint64_t CollisionEventStream::getKey(const btCollisionObject* object, BodyHandle& handle) const
+{
+	//Handle keys have the top bit set, which no user space address has, so they can't be mistaken for one another
+	handle = mRegistry ? mRegistry->getHandle(object) : BodyHandle();
+	if (handle) return (std::uint64_t(1) << 63) | (std::uint64_t(handle.index) << 31) | (handle.generation & 0x7FFFFFFF);
+
+	return std::uint64_t(reinterpret_cast<std::uintptr_t>(object));
+}
+
+void CollisionEventStream::update()
+{
+	std::swap(mPairs, mPreviousPairs);
+	mPairs.clear();
+
+	//Every manifold with at least one touching point is a pair
+	const auto dispatcher = mWorld->getDispatcher();
+	for (auto i = 0; i < dispatcher->getNumManifolds(); ++i)
+	{
+		const auto manifold = dispatcher->getManifoldByIndexInternal(i);
+
+		auto deepest = -1;
+		auto impulse = btScalar(0);
+		for (auto j = 0; j < manifold->getNumContacts(); ++j)
+		{
+			const auto& point = manifold->getContactPoint(j);
+			if (point.getDistance() > 0) continue;
+
+			impulse += point.getAppliedImpulse();
+			if (deepest < 0 || point.getDistance() < manifold->getContactPoint(deepest).getDistance()) deepest = j;
+		}
+		if (deepest < 0) continue;
+
+		const auto& point = manifold->getContactPoint(deepest);
+		Pair pair{ 0, 0, manifold->getBody0(), manifold->getBody1(), {}, {}, point.getPositionWorldOnB(), point.m_normalWorldOnB, point.getDistance(), impulse };
+		pair.keyA = getKey(pair.objectA, pair.bodyA);
+		pair.keyB = getKey(pair.objectB, pair.bodyB);
+
+		//Order the objects by key, the contact point and normal are then given on the surface of the new B, pointing to the new A
+		if (pair.keyB < pair.keyA)
+		{
+			std::swap(pair.keyA, pair.keyB);
+			std::swap(pair.objectA, pair.objectB);
+			std::swap(pair.bodyA, pair.bodyB);
+			pair.point = point.getPositionWorldOnA();
+			pair.normal = -pair.normal;
+		}
+
+		mPairs.push_back(pair);
+	}
+
+	std::sort(mPairs.begin(), mPairs.end());
+
+	//Some pairs (e.g. compounds) have more than one manifold: keep the deepest point, sum the impulses
+	auto last = size_t{ 0U };
+	for (auto i = size_t{ 1U }; i < mPairs.size(); ++i)
+	{
+		if (mPairs[i].samePair(mPairs[last]))
+		{
+			const auto impulse = mPairs[last].impulse + mPairs[i].impulse;
+			if (mPairs[i].distance < mPairs[last].distance) mPairs[last] = mPairs[i];
+			mPairs[last].impulse = impulse;
+		}
+		else
+		{
+			mPairs[++last] = mPairs[i];
+		}
+	}
+	if (!mPairs.empty()) mPairs.resize(last + 1);
+
+	//Both lists are sorted: walk them together
+	auto current = mPairs.begin();
+	auto previous = mPreviousPairs.begin();
+	while (current != mPairs.end() || previous != mPreviousPairs.end())
+	{
+		if (previous == mPreviousPairs.end() || (current != mPairs.end() && *current < *previous))
+		{
+			push(CollisionEventType::Begin, *current, current->impulse);
+			++current;
+		}
+		else if (current == mPairs.end() || *previous < *current)
+		{
+			push(CollisionEventType::End, *previous, 0);
+			++previous;
+		}
+		else
+		{
+			if (mReportPersist) push(CollisionEventType::Persist, *current, current->impulse);
+			++current;
+			++previous;
+		}
+	}
+}
+
+void CollisionEventStream::push(CollisionEventType type, const Pair& pair, btScalar impulse)
+{
+	const CollisionEvent event{ type, pair.objectA, pair.objectB, pair.bodyA, pair.bodyB, Convert::toOgre(pair.point), Convert::toOgre(pair.normal), Real(impulse) };
+
+	if (mCount == mEvents.size())
+	{
+		//Full: overwrite the oldest
+		mEvents[mHead] = event;
+		mHead = (mHead + 1) % mEvents.size();
+		++mDropped;
+		return;
+	}
+
+	mEvents[(mHead + mCount) % mEvents.size()] = event;
+	++mCount;
+}
+
+void CollisionEventStream::setReportPersist(bool report)
+{
+	mReportPersist = report;
+}
+
+size_t CollisionEventStream::getEventCount() const
+{
+	return mCount;
+}
+
+const CollisionEvent& CollisionEventStream::getEvent(size_t index) const
+{
+	return mEvents[(mHead + index) % mEvents.size()];
+}
+
+bool CollisionEventStream::pop(CollisionEvent& event)
+{
+	if (!mCount) return false;
+
+	event = mEvents[mHead];
+	mHead = (mHead + 1) % mEvents.size();
+	--mCount;
+	return true;
+}
+
+void CollisionEventStream::clear()
+{
+	mHead = 0;
+	mCount = 0;
+}
+
+size_t CollisionEventStream::getDroppedCount() const
+{
+	return mDropped;
+}
@@ -1,4 +1,5 @@
 #include "BtOgreExtras.h"
+#include "BtOgreProfiling.h"
 #include <utility>
 
 using namespace Ogre;
@@ -68,6 +69,9 @@ void LineDrawer::checkForMaterial() const
 
 void LineDrawer::update()
 {
+	BTOGRE_PROFILE_ZONE(DebugLineUpload);
+	BTOGRE_PROFILE_COUNT(LinesDrawn, lines.size());
+
 	if (!manualObject)
 	{
 		DebugDrawer::logToOgre("Create manual object");
@@ -98,6 +102,11 @@ void LineDrawer::update()
 	manualObject->end();
 }
 
+size_t LineDrawer::getLineCount() const
+{
+	return lines.size();
+}
+
 void DebugDrawer::logToOgre(const std::string& message)
 {
 	Ogre::LogManager::getSingleton().logMessage("BtOgre21Log : " + message);
@@ -189,15 +198,27 @@ int DebugDrawer::getDebugMode() const
 }
 
 void DebugDrawer::step()
+{
+	collectLines();
+	uploadLines();
+}
+
+void DebugDrawer::collectLines()
 {
 	if (mDebugMode)
-	{
 		mWorld->debugDrawWorld();
+}
+
+void DebugDrawer::uploadLines()
+{
+	if (mDebugMode)
 		drawer.update();
-	}
 	else
-	{
 		drawer.clear();
-	}
 	stepped = true;
+}
+
+size_t DebugDrawer::getLineCount() const
+{
+	return drawer.getLineCount();
 }
\ No newline at end of file
@@ -16,6 +16,12 @@
 #include "BtOgrePG.h"
 #include "BtOgreGP.h"
 #include "BtOgreExtras.h"
+#include "BtOgreProfiling.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include <LinearMath/btConvexHullComputer.h>
 
 using namespace Ogre;
 using namespace BtOgre;
@@ -34,6 +40,7 @@ inline void log(const std::string& message)
 void VertexIndexToShape::appendV1VertexData(const v1::VertexData *vertex_data)
 {
 	if (!vertex_data) return;
+	BTOGRE_PROFILE_ZONE(V1VertexData);
 
 	const auto previousSize = mVertexBuffer.size();
 
@@ -46,18 +53,15 @@ void VertexIndexToShape::appendV1VertexData(const v1::VertexData *vertex_data)
 	const auto vertexSize = static_cast<unsigned int>(vbuf->getVertexSize());
 
 	//Get read only access to the row buffer
-	const auto vertex = static_cast<unsigned char*>(vbuf->lock(v1::HardwareBuffer::HBL_READ_ONLY));
-	Real* rawVertex{ nullptr }; // this pointer will be used a a buffer to write the [float, float, float] array of the vertex
-
-	//Write data to the vertex buffer
-	const auto vertexCount = static_cast<unsigned int>(vertex_data->vertexCount);
-	for (auto j = size_t{ 0U }; j < vertexCount; ++j)
+	unsigned char* vertex;
 	{
-		//Get pointer to the start of this vertex
-		posElem->baseVertexPointerToElement(vertex + j * vertexSize, &rawVertex);
-		mVertexBuffer[previousSize + j] = mTransform * Vector3{ rawVertex };
+		BTOGRE_PROFILE_ZONE(BufferMapping);
+		vertex = static_cast<unsigned char*>(vbuf->lock(v1::HardwareBuffer::HBL_READ_ONLY));
 	}
 
+	//Write data to the vertex buffer, in the format the positions are stored in
+	writePositions(vertex + posElem->getOffset(), vertexSize, posElem->getType(), vertex_data->vertexCount, previousSize);
+
 	//Release vertex buffer opened in read only
 	vbuf->unlock();
 }
@@ -154,10 +158,11 @@ Vector3 VertexIndexToShape::getCenterOffset()
 
 Vector3 VertexIndexToShape::getSize()
 {
-	if (mBounds == Vector3(-1, -1, -1) && getVertexCount())
+	const auto hasVertices = !mVertexBuffer.empty();
+	if (mBounds == Vector3(-1, -1, -1) && (hasVertices || !mDeferredBounds.isNull()))
 	{
-		auto vmin = mVertexBuffer[0];
-		auto vmax = vmin;
+		auto vmin = hasVertices ? mVertexBuffer[0] : mDeferredBounds.getMinimum();
+		auto vmax = hasVertices ? mVertexBuffer[0] : mDeferredBounds.getMaximum();
 
 		for (const auto vertex : mVertexBuffer)
 		{
@@ -169,6 +174,13 @@ Vector3 VertexIndexToShape::getSize()
 			vmax.z = std::max(vmax.z, vertex.z);
 		}
 
+		//Geometry not extracted yet only contributes its bounding box. No buffer is read for that
+		if (!mDeferredBounds.isNull())
+		{
+			vmin.makeFloor(mDeferredBounds.getMinimum());
+			vmax.makeCeil(mDeferredBounds.getMaximum());
+		}
+
 		mBounds = vmax - vmin;
 		mCenter = vmin + mBounds/2;
 	}
@@ -179,24 +191,28 @@ Vector3 VertexIndexToShape::getSize()
 //These should be const
 const Vector3* VertexIndexToShape::getVertices()
 {
+	extractDeferredGeometry();
 	return mVertexBuffer.data();
 }
 
-size_t VertexIndexToShape::getVertexCount() const
+size_t VertexIndexToShape::getVertexCount()
 {
+	extractDeferredGeometry();
 	return mVertexBuffer.size();
 }
 const unsigned int* VertexIndexToShape::getIndices()
 {
+	extractDeferredGeometry();
 	return mIndexBuffer.data();
 }
 
-size_t VertexIndexToShape::getIndexCount() const
+size_t VertexIndexToShape::getIndexCount()
 {
+	extractDeferredGeometry();
 	return mIndexBuffer.size();
 }
 
-size_t VertexIndexToShape::getTriangleCount() const
+size_t VertexIndexToShape::getTriangleCount()
 {
 	return getIndexCount() / 3;
 }
@@ -254,10 +270,18 @@ btCylinderShape* VertexIndexToShape::createCylinder()
 }
 btConvexHullShape* VertexIndexToShape::createConvex()
 {
+	extractDeferredGeometry();
 	assert(getVertexCount() && (getIndexCount() >= 6) &&
 		("Mesh must have some vertices and at least 6 indices (2 triangles)"));
 
-	auto shape = new btConvexHullShape{ static_cast<btScalar*>(&mVertexBuffer[0].x), int(getVertexCount()), sizeof(Vector3) };
+	const auto cache = mShapeCache ? mShapeCache : ShapeCache::getDefault();
+	const auto key = cache ? ShapeCache::computeKey(ShapeCache::CONVEX, mVertexBuffer.data(), mVertexBuffer.size(), mIndexBuffer.data(), mIndexBuffer.size(), mScale) : 0;
+
+	auto shape = cache ? cache->loadConvex(key) : nullptr;
+	if (!shape && cache)
+		shape = cache->storeConvex(key, mVertexBuffer.data(), mVertexBuffer.size());
+	else if (!shape)
+		shape = new btConvexHullShape{ static_cast<btScalar*>(&mVertexBuffer[0].x), int(getVertexCount()), sizeof(Vector3) };
 
 	shape->setLocalScaling(Convert::toBullet(mScale));
 
@@ -266,9 +290,21 @@ btConvexHullShape* VertexIndexToShape::createConvex()
 
 btBvhTriangleMeshShape* VertexIndexToShape::createTrimesh()
 {
+	BTOGRE_PROFILE_ZONE(Trimesh);
+	extractDeferredGeometry();
 	assert(getVertexCount() && (getIndexCount() >= 6) &&
 		("Mesh must have some vertices and at least 6 indices (2 triangles)"));
 
+	if (mMortonOrdering)
+		sortTrianglesByMortonCode();
+
+	//The key is computed after the sort, the cached triangles are in the same order as the ones of a fresh shape
+	const auto cache = mShapeCache ? mShapeCache : ShapeCache::getDefault();
+	const auto key = cache ? ShapeCache::computeKey(ShapeCache::TRIMESH, mVertexBuffer.data(), mVertexBuffer.size(), mIndexBuffer.data(), mIndexBuffer.size(), mScale) : 0;
+	if (cache)
+		if (const auto cached = cache->loadTrimesh(key, mVertexBuffer.size(), mIndexBuffer.size(), Convert::toBullet(mScale)))
+			return cached;
+
 	const auto numFaces = getTriangleCount();
 	auto trimesh = new btTriangleMesh();
 
@@ -281,11 +317,157 @@ btBvhTriangleMeshShape* VertexIndexToShape::createTrimesh()
 		trimesh->addTriangle(vertexPos[0], vertexPos[1], vertexPos[2]);
 	}
 
-	const auto useQuantizedAABB = true;
-	auto shape = new btBvhTriangleMeshShape(trimesh, useQuantizedAABB);
+	btBvhTriangleMeshShape* shape;
+	{
+		//A scale other than 1 rebuilds the BVH
+		BTOGRE_PROFILE_ZONE(BvhBuild);
+		const auto useQuantizedAABB = true;
+		shape = new btBvhTriangleMeshShape(trimesh, useQuantizedAABB);
+		shape->setLocalScaling(Convert::toBullet(mScale));
+	}
 
-	shape->setLocalScaling(Convert::toBullet(mScale));
+	if (cache) cache->storeTrimesh(key, mVertexBuffer.data(), mVertexBuffer.size(), mIndexBuffer.data(), mIndexBuffer.size(), shape);
+
+	return shape;
+}
+
+const std::vector<unsigned short>& VertexIndexToShape::getTriangleSubMeshes()
+{
+	extractDeferredGeometry();
+	return mTriangleSubMesh;
+}
+
+const std::vector<SubMeshMaterial>& VertexIndexToShape::getSubMeshMaterials()
+{
+	extractDeferredGeometry();
+	return mSubMeshMaterials;
+}
+
+TriangleMaterialMap VertexIndexToShape::getTriangleMaterialMap()
+{
+	extractDeferredGeometry();
+	return { mTriangleSubMesh, mSubMeshMaterials };
+}
+
+void VertexIndexToShape::tagSubMeshTriangles(const String& materialName, HlmsDatablock* datablock)
+{
+	tagSubMeshTriangles(materialName, datablock, mIndexBuffer.size() / 3);
+}
+
+void VertexIndexToShape::tagSubMeshTriangles(const String& materialName, HlmsDatablock* datablock, size_t endTriangle)
+{
+	const auto subMesh = static_cast<unsigned short>(mSubMeshMaterials.size());
+	mSubMeshMaterials.push_back({ materialName, datablock });
+	mTriangleSubMesh.resize(std::max(endTriangle, mTriangleSubMesh.size()), subMesh);
+}
+
+void VertexIndexToShape::setMortonOrdering(bool enabled)
+{
+	mMortonOrdering = enabled;
+}
+
+void VertexIndexToShape::setShapeCache(ShapeCache* cache)
+{
+	mShapeCache = cache;
+}
+
+///Spread the 10 lower bits of a value so that there's 2 zero bits between each of them
+static unsigned int expandMortonBits(unsigned int v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+void VertexIndexToShape::sortTrianglesByMortonCode()
+{
+	const auto numFaces = getTriangleCount();
+	if (numFaces < 2) return;
+
+	//Get the centroid of each triangle, and the bounds of theses centroids
+	std::vector<Vector3> centroids(numFaces);
+	auto cmin = Vector3{ std::numeric_limits<Real>::max() };
+	auto cmax = -cmin;
+	for (auto i = size_t{ 0U }; i < numFaces; ++i)
+	{
+		centroids[i] = (mVertexBuffer[mIndexBuffer[3 * i]]
+			+ mVertexBuffer[mIndexBuffer[3 * i + 1]]
+			+ mVertexBuffer[mIndexBuffer[3 * i + 2]]) / 3;
+		cmin.makeFloor(centroids[i]);
+		cmax.makeCeil(centroids[i]);
+	}
+
+	//Quantize the centroids on a 1024x1024x1024 grid to compute a 30bit Morton code
+	const auto extent = cmax - cmin;
+	const Vector3 gridScale
+	{
+		extent.x > 0 ? 1023 / extent.x : 0,
+		extent.y > 0 ? 1023 / extent.y : 0,
+		extent.z > 0 ? 1023 / extent.z : 0
+	};
+
+	//Sorting (code, triangle) pairs keep the original order between triangles that share a code
+	std::vector<std::pair<unsigned int, unsigned int>> keys(numFaces);
+	for (auto i = size_t{ 0U }; i < numFaces; ++i)
+	{
+		const auto cell = (centroids[i] - cmin) * gridScale;
+		const auto x = std::min(1023u, static_cast<unsigned int>(cell.x));
+		const auto y = std::min(1023u, static_cast<unsigned int>(cell.y));
+		const auto z = std::min(1023u, static_cast<unsigned int>(cell.z));
+		keys[i] = { (expandMortonBits(x) << 2) | (expandMortonBits(y) << 1) | expandMortonBits(z), static_cast<unsigned int>(i) };
+	}
+	std::sort(keys.begin(), keys.end());
+
+	//Rebuild the index buffer in Morton order, and number the vertices in the order they are first used
+	const auto unassigned = std::numeric_limits<unsigned int>::max();
+	std::vector<unsigned int> remap(mVertexBuffer.size(), unassigned);
+	VertexBuffer sortedVertices;
+	sortedVertices.reserve(mVertexBuffer.size());
+	IndexBuffer sortedIndices(mIndexBuffer.size());
+
+	const auto remapVertex = [&](unsigned int vertex)
+	{
+		if (remap[vertex] == unassigned)
+		{
+			remap[vertex] = static_cast<unsigned int>(sortedVertices.size());
+			sortedVertices.push_back(mVertexBuffer[vertex]);
+		}
+		return remap[vertex];
+	};
+
+	for (auto i = size_t{ 0U }; i < numFaces; ++i)
+		for (const auto j : { 0, 1, 2 })
+			sortedIndices[3 * i + j] = remapVertex(mIndexBuffer[3 * keys[i].second + j]);
+
+	//Trailing indices that don't make a full triangle are kept as is
+	for (auto i = 3 * numFaces; i < mIndexBuffer.size(); ++i)
+		sortedIndices[i] = remapVertex(mIndexBuffer[i]);
+
+	//Vertices not used by any triangle still count for bounds and convex hulls, keep them at the end
+	for (auto i = size_t{ 0U }; i < mVertexBuffer.size(); ++i)
+		if (remap[i] == unassigned)
+			sortedVertices.push_back(mVertexBuffer[i]);
+
+	mVertexBuffer.swap(sortedVertices);
+	mIndexBuffer.swap(sortedIndices);
+
+	//The submesh of each triangle follow the triangles
+	if (mTriangleSubMesh.size() == numFaces)
+	{
+		std::vector<unsigned short> sortedSubMeshes(numFaces);
+		for (auto i = size_t{ 0U }; i < numFaces; ++i)
+			sortedSubMeshes[i] = mTriangleSubMesh[keys[i].second];
+		mTriangleSubMesh.swap(sortedSubMeshes);
+	}
+}
 
+btBvhTriangleMeshShape* VertexIndexToShape::createTrimesh(TriangleMaterialMap& materials)
+{
+	//The triangles may be reordered by createTrimesh(), the table has to be built after
+	auto shape = createTrimesh();
+	materials = getTriangleMaterialMap();
 	return shape;
 }
 
@@ -321,6 +503,220 @@ btCapsuleShape* VertexIndexToShape::createCapsule()
 	return shape;
 }
 
+btCompoundShape* VertexIndexToShape::createPrimitiveCompound(Real maxFitError, size_t maxHullVertices)
+{
+	extractDeferredGeometry();
+	assert(getVertexCount() && (getIndexCount() >= 3) &&
+		("Mesh must have some vertices and at least 3 indices (1 triangle)"));
+
+	const auto numFaces = getTriangleCount();
+
+	//Without submesh information, the whole object is fitted as one
+	const auto hasSubMeshes = mTriangleSubMesh.size() == numFaces && !mSubMeshMaterials.empty();
+	const auto subMeshCount = hasSubMeshes ? mSubMeshMaterials.size() : size_t{ 1U };
+
+	std::vector<std::vector<unsigned int>> subMeshTriangles(subMeshCount);
+	for (auto i = size_t{ 0U }; i < numFaces; ++i)
+		subMeshTriangles[hasSubMeshes ? mTriangleSubMesh[i] : 0].push_back(static_cast<unsigned int>(i));
+
+	auto compound = new btCompoundShape();
+
+	//Used to only take each vertex once per submesh
+	std::vector<size_t> vertexStamp(getVertexCount(), 0);
+	std::vector<Vector3> vertices;
+	std::vector<Vector3> samples;
+	btAlignedObjectArray<btVector3> points;
+
+	for (auto subMesh = size_t{ 0U }; subMesh < subMeshCount; ++subMesh)
+	{
+		const auto& triangles = subMeshTriangles[subMesh];
+		if (triangles.empty()) continue;
+
+		//The surface is sampled at the vertices and at the triangle centroids. Vertices alone would lie on the bounding sphere of a box
+		vertices.clear();
+		samples.clear();
+		for (const auto triangle : triangles)
+		{
+			auto centroid = Vector3::ZERO;
+			for (const auto j : { 0, 1, 2 })
+			{
+				const auto vertex = mIndexBuffer[3 * triangle + j];
+				centroid += mVertexBuffer[vertex];
+				if (vertexStamp[vertex] != subMesh + 1)
+				{
+					vertexStamp[vertex] = subMesh + 1;
+					vertices.push_back(mVertexBuffer[vertex]);
+				}
+			}
+			samples.push_back(centroid / 3);
+		}
+		samples.insert(samples.end(), vertices.begin(), vertices.end());
+
+		auto vmin = vertices[0];
+		auto vmax = vmin;
+		for (const auto& vertex : vertices)
+		{
+			vmin.makeFloor(vertex);
+			vmax.makeCeil(vertex);
+		}
+		const auto center = vmin + (vmax - vmin) / 2;
+		const auto halfSize = (vmax - vmin) / 2;
+		const auto size = std::max(halfSize.x, std::max(halfSize.y, halfSize.z));
+		if (size <= 0) continue;
+
+		//Round shapes are aligned on the biggest axis
+		const auto axis = halfSize.x >= halfSize.y && halfSize.x >= halfSize.z ? 0 : (halfSize.z >= halfSize.y ? 2 : 1);
+		Real radius = 0;
+		Real radial = 0;
+		for (const auto& vertex : vertices)
+		{
+			const auto p = vertex - center;
+			radius = std::max(radius, p.length());
+			radial = std::max(radial, Math::Sqrt(std::max(Real(0), p.squaredLength() - p[axis] * p[axis])));
+		}
+		const auto capsuleHalfHeight = std::max(Real(0), halfSize[axis] - radial);
+
+		//Relative RMS of the signed distance from the samples to the surface of each primitive
+		Real boxError = 0, sphereError = 0, cylinderError = 0, capsuleError = 0;
+		for (const auto& sample : samples)
+		{
+			const auto p = sample - center;
+			const Vector3 absP{ std::abs(p.x), std::abs(p.y), std::abs(p.z) };
+			const auto pRadial = Math::Sqrt(std::max(Real(0), p.squaredLength() - p[axis] * p[axis]));
+
+			const auto q = absP - halfSize;
+			const auto boxDistance = Vector3{ std::max(q.x, Real(0)), std::max(q.y, Real(0)), std::max(q.z, Real(0)) }.length()
+				+ std::min(std::max(q.x, std::max(q.y, q.z)), Real(0));
+
+			const auto sphereDistance = p.length() - radius;
+
+			const auto dr = pRadial - radial;
+			const auto dh = absP[axis] - halfSize[axis];
+			const auto cylinderDistance = std::min(std::max(dr, dh), Real(0))
+				+ Math::Sqrt(Math::Sqr(std::max(dr, Real(0))) + Math::Sqr(std::max(dh, Real(0))));
+
+			const auto alongAxis = absP[axis] - std::min(absP[axis], capsuleHalfHeight);
+			const auto capsuleDistance = Math::Sqrt(pRadial * pRadial + alongAxis * alongAxis) - radial;
+
+			boxError += boxDistance * boxDistance;
+			sphereError += sphereDistance * sphereDistance;
+			cylinderError += cylinderDistance * cylinderDistance;
+			capsuleError += capsuleDistance * capsuleDistance;
+		}
+
+		const auto toRelativeError = [&](Real sum) { return Math::Sqrt(sum / samples.size()) / size; };
+		boxError = toRelativeError(boxError);
+		sphereError = toRelativeError(sphereError);
+		cylinderError = toRelativeError(cylinderError);
+		capsuleError = toRelativeError(capsuleError);
+
+		btCollisionShape* child = nullptr;
+		btTransform childTransform{ btQuaternion::getIdentity(), Convert::toBullet(center) };
+		const auto bestError = std::min(std::min(boxError, sphereError), std::min(cylinderError, capsuleError));
+
+		if (bestError <= maxFitError)
+		{
+			//Flat or thin submeshes (floors, decals...) fit with a zero extent. Bullet removes the margin from the extents, they are kept above it
+			const auto minExtent = Real(CONVEX_DISTANCE_MARGIN);
+			auto extents = halfSize;
+			extents.makeCeil(Vector3{ minExtent, minExtent, minExtent });
+			const auto shapeRadial = std::max(radial, minExtent);
+			const auto shapeHalfHeight = std::max(Real(0), extents[axis] - shapeRadial);
+
+			if (bestError == boxError)
+			{
+				child = new btBoxShape(Convert::toBullet(extents));
+			}
+			else if (bestError == sphereError)
+			{
+				child = new btSphereShape(std::max(radius, minExtent));
+			}
+			else if (bestError == cylinderError)
+			{
+				auto cylinderExtents = btVector3{ shapeRadial, shapeRadial, shapeRadial };
+				cylinderExtents[axis] = extents[axis];
+				if (axis == 0) child = new btCylinderShapeX(cylinderExtents);
+				else if (axis == 2) child = new btCylinderShapeZ(cylinderExtents);
+				else child = new btCylinderShape(cylinderExtents);
+			}
+			else
+			{
+				if (axis == 0) child = new btCapsuleShapeX(shapeRadial, 2 * shapeHalfHeight);
+				else if (axis == 2) child = new btCapsuleShapeZ(shapeRadial, 2 * shapeHalfHeight);
+				else child = new btCapsuleShape(shapeRadial, 2 * shapeHalfHeight);
+			}
+		}
+		else if (maxHullVertices > 0 && vertices.size() >= 4)
+		{
+			points.clear();
+			for (const auto& vertex : vertices)
+				points.push_back(Convert::toBullet(vertex - center));
+
+			btConvexHullComputer hull;
+			hull.compute(&points[0].x(), sizeof(btVector3), points.size(), 0, 0);
+
+			if (hull.faces.size() >= 4 && size_t(hull.vertices.size()) <= maxHullVertices)
+			{
+				//Face planes of the hull, oriented outward
+				btVector3 hullCenter{ 0, 0, 0 };
+				for (auto i = 0; i < hull.vertices.size(); ++i)
+					hullCenter += hull.vertices[i];
+				hullCenter /= btScalar(hull.vertices.size());
+
+				//Each plane is stored as its normal, and its distance to the origin in w
+				btAlignedObjectArray<btVector4> planes;
+				for (auto i = 0; i < hull.faces.size(); ++i)
+				{
+					auto edge = &hull.edges[hull.faces[i]];
+					const auto& a = hull.vertices[edge->getSourceVertex()];
+					edge = edge->getNextEdgeOfFace();
+					const auto& b = hull.vertices[edge->getSourceVertex()];
+					edge = edge->getNextEdgeOfFace();
+					const auto& c = hull.vertices[edge->getSourceVertex()];
+
+					auto normal = (b - a).cross(c - a);
+					if (normal.length2() <= SIMD_EPSILON) continue;
+					normal.normalize();
+					if (normal.dot(hullCenter - a) > 0) normal = -normal;
+					planes.push_back(btVector4{ normal.x(), normal.y(), normal.z(), normal.dot(a) });
+				}
+
+				Real hullError = 0;
+				for (const auto& sample : samples)
+				{
+					const auto p = Convert::toBullet(sample - center);
+					auto distance = -std::numeric_limits<btScalar>::max();
+					for (auto j = 0; j < planes.size(); ++j)
+						distance = std::max(distance, planes[j].dot(p) - planes[j].w());
+					hullError += distance * distance;
+				}
+
+				if (toRelativeError(hullError) <= maxFitError)
+					child = new btConvexHullShape{ &hull.vertices[0].x(), hull.vertices.size(), sizeof(btVector3) };
+			}
+		}
+
+		//Nothing fits well enough, fall back to a trimesh of this submesh
+		if (!child)
+		{
+			auto trimesh = new btTriangleMesh();
+			for (const auto triangle : triangles)
+				trimesh->addTriangle(Convert::toBullet(mVertexBuffer[mIndexBuffer[3 * triangle]]),
+					Convert::toBullet(mVertexBuffer[mIndexBuffer[3 * triangle + 1]]),
+					Convert::toBullet(mVertexBuffer[mIndexBuffer[3 * triangle + 2]]));
+
+			child = new btBvhTriangleMeshShape(trimesh, true);
+			childTransform.setIdentity();
+		}
+
+		compound->addChildShape(childTransform, child);
+	}
+
+	compound->setLocalScaling(Convert::toBullet(mScale));
+
+	return compound;
+}
+
 VertexIndexToShape::~VertexIndexToShape()
 {
 	if (mBoneIndex)
@@ -338,10 +734,45 @@ VertexIndexToShape::VertexIndexToShape(const Matrix4 &transform) :
 	mBoundRadius(-1),
 	mBoneIndex(nullptr),
 	mTransform(transform),
-	mScale(1)
+	mScale(1),
+	mMortonOrdering(false),
+	mShapeCache(nullptr)
 {
 }
 
+/*
+ * =============================================================================================
+ * BtOgre::TriangleMaterialMap
+ * =============================================================================================
+ */
+
+TriangleMaterialMap::TriangleMaterialMap(std::vector<unsigned short> triangleSubMesh, std::vector<SubMeshMaterial> subMeshMaterials) :
+	mTriangleSubMesh(std::move(triangleSubMesh)),
+	mSubMeshMaterials(std::move(subMeshMaterials))
+{
+}
+
+unsigned short TriangleMaterialMap::getSubMesh(int triangleIndex) const
+{
+	assert(triangleIndex >= 0 && size_t(triangleIndex) < mTriangleSubMesh.size());
+	return mTriangleSubMesh[triangleIndex];
+}
+
+const SubMeshMaterial& TriangleMaterialMap::getMaterial(int triangleIndex) const
+{
+	return mSubMeshMaterials[getSubMesh(triangleIndex)];
+}
+
+size_t TriangleMaterialMap::getTriangleCount() const
+{
+	return mTriangleSubMesh.size();
+}
+
+size_t TriangleMaterialMap::getSubMeshCount() const
+{
+	return mSubMeshMaterials.size();
+}
+
 /*
  * =============================================================================================
  * BtOgre::StaticMeshToShapeConverter
@@ -374,11 +805,24 @@ StaticMeshToShapeConverter::StaticMeshToShapeConverter(v1::Mesh *mesh, const Mat
 	addMesh(mesh, transform);
 }
 
-StaticMeshToShapeConverter::StaticMeshToShapeConverter(Item* item, const Matrix4& transform)
+StaticMeshToShapeConverter::StaticMeshToShapeConverter(Item* item, const Matrix4& transform) :
+	VertexIndexToShape(transform),
+	mEntity(nullptr),
+	mItem(nullptr),
+	mNode(nullptr)
 {
 	addItem(item, transform);
 }
 
+StaticMeshToShapeConverter::StaticMeshToShapeConverter(const MeshFileReader& meshFile, const Matrix4& transform) :
+	VertexIndexToShape(transform),
+	mEntity(nullptr),
+	mItem(nullptr),
+	mNode(nullptr)
+{
+	addMeshFile(meshFile, transform);
+}
+
 StaticMeshToShapeConverter::StaticMeshToShapeConverter(Renderable *rend, const Matrix4 &transform) :
 	VertexIndexToShape(transform),
 	mEntity(nullptr),
@@ -390,6 +834,7 @@ StaticMeshToShapeConverter::StaticMeshToShapeConverter(Renderable *rend, const M
 	appendV1VertexData(op.vertexData);
 	if (op.useIndexes)
 		appendV1IndexData(op.indexData);
+	tagSubMeshTriangles(BLANKSTRING, rend->getDatablock());
 }
 
 void StaticMeshToShapeConverter::addEntity(v1::Entity *entity, const Matrix4 &transform)
@@ -402,16 +847,61 @@ void StaticMeshToShapeConverter::addEntity(v1::Entity *entity, const Matrix4 &tr
 }
 
 void StaticMeshToShapeConverter::addMesh(const v1::Mesh *mesh, const Matrix4 &transform)
+{
+	if (mesh->hasSkeleton())
+		log("MeshToShapeConverter::addMesh : Mesh " + mesh->getName() + " as skeleton but added to trimesh non animated");
+
+	//Datablocks can only be known if the mesh comes from the stored entity
+	const auto entity = mEntity && mEntity->getMesh().get() == mesh ? mEntity : nullptr;
+
+	deferMesh({ nullptr, mesh, nullptr, entity, transform }, mesh->getBounds());
+}
+
+void StaticMeshToShapeConverter::deferMesh(const DeferredMesh& deferred, AxisAlignedBox bounds)
 {
 	// Each entity added need to reset size and radius
 	// next time getRadius and getSize are asked, they will be computed.
 	mBounds = Vector3(-1, -1, -1);
 	mBoundRadius = -1;
 
-	mTransform = transform;
+	mTransform = deferred.transform;
 
-	if (mesh->hasSkeleton())
-		log("MeshToShapeConverter::addMesh : Mesh " + mesh->getName() + " as skeleton but added to trimesh non animated");
+	//Without finite bounds, the only way to know the size of the mesh is to read it
+	if (!bounds.isFinite())
+	{
+		if (deferred.mesh) extractMesh(deferred.mesh, deferred.transform, deferred.item);
+		else extractMesh(deferred.v1Mesh, deferred.transform, deferred.entity);
+		return;
+	}
+
+	bounds.transform(deferred.transform);
+	mDeferredBounds.merge(bounds);
+	mDeferredMeshes.push_back(deferred);
+}
+
+void StaticMeshToShapeConverter::extractDeferredGeometry()
+{
+	if (mDeferredMeshes.empty()) return;
+
+	//Take the list first, the extraction code may call the accessors too
+	std::vector<DeferredMesh> deferredMeshes;
+	deferredMeshes.swap(mDeferredMeshes);
+
+	for (const auto& deferred : deferredMeshes)
+	{
+		if (deferred.mesh) extractMesh(deferred.mesh, deferred.transform, deferred.item);
+		else extractMesh(deferred.v1Mesh, deferred.transform, deferred.entity);
+	}
+
+	//Bounds will be computed again from the actual vertices
+	mDeferredBounds.setNull();
+	mBounds = Vector3(-1, -1, -1);
+	mBoundRadius = -1;
+}
+
+void StaticMeshToShapeConverter::extractMesh(const v1::Mesh* mesh, const Matrix4& transform, v1::Entity* entity)
+{
+	mTransform = transform;
 
 	if (mesh->sharedVertexData[0])
 	{
@@ -424,13 +914,59 @@ void StaticMeshToShapeConverter::addMesh(const v1::Mesh *mesh, const Matrix4 &tr
 
 		if (!sub_mesh->useSharedVertices)
 		{
-			appendV1IndexData(sub_mesh->indexData[0], getVertexCount());
+			appendV1IndexData(sub_mesh->indexData[0], mVertexBuffer.size());
 			appendV1VertexData(sub_mesh->vertexData[0]);
 		}
 		else
 		{
 			appendV1IndexData(sub_mesh->indexData[0]);
 		}
+
+		tagSubMeshTriangles(sub_mesh->getMaterialName(), entity ? entity->getSubEntity(i)->getDatablock() : nullptr);
+	}
+}
+
+void StaticMeshToShapeConverter::addMeshFile(const MeshFileReader& meshFile, const Matrix4& transform)
+{
+	mBounds = Vector3(-1, -1, -1);
+	mBoundRadius = -1;
+	mTransform = transform;
+
+	if (meshFile.hasSkeleton())
+		log("MeshToShapeConverter::addMeshFile : Mesh file has skeleton but added to trimesh non animated");
+
+	//The positions are stored as Vector3, made of doubles if Ogre was built with OGRE_DOUBLE_PRECISION
+	const auto vertexFormat = sizeof(Real) == sizeof(double) ? VET_DOUBLE3 : VET_FLOAT3;
+	const auto appendVertices = [this, vertexFormat](const std::vector<Vector3>& vertices)
+	{
+		const auto previousSize = mVertexBuffer.size();
+		mVertexBuffer.resize(previousSize + vertices.size());
+		writePositions(reinterpret_cast<const unsigned char*>(vertices.data()), sizeof(Vector3), vertexFormat, vertices.size(), previousSize);
+	};
+
+	const auto appendIndices = [this](const std::vector<unsigned int>& indices, size_t offset)
+	{
+		const auto previousSize = mIndexBuffer.size();
+		mIndexBuffer.resize(previousSize + indices.size());
+		writeIndices(indices.data(), indices.size(), previousSize, offset);
+	};
+
+	const auto sharedOffset = mVertexBuffer.size();
+	appendVertices(meshFile.getSharedVertices());
+
+	for (const auto& subMesh : meshFile.getSubMeshes())
+	{
+		if (subMesh.useSharedVertices)
+		{
+			appendIndices(subMesh.indices, sharedOffset);
+		}
+		else
+		{
+			appendIndices(subMesh.indices, mVertexBuffer.size());
+			appendVertices(subMesh.vertices);
+		}
+
+		tagSubMeshTriangles(subMesh.materialName, nullptr);
 	}
 }
 
@@ -440,10 +976,11 @@ void VertexIndexToShape::getV2MeshBufferSize(const Mesh* mesh, size_t& previousV
 	size_t numIndices = 0U;
 
 	previousVertexSize = mVertexBuffer.size();
-	previousIndexSize = mVertexBuffer.size();
+	previousIndexSize = mIndexBuffer.size();
 
 	for (const auto subMesh : mesh->getSubMeshes())
 	{
+		if (subMesh->mVao[0].empty()) continue;
 		numVertices += subMesh->mVao[0][0]->getVertexBuffers()[0]->getNumElements();
 		numIndices += subMesh->mVao[0][0]->getIndexBuffer()->getNumElements();
 	}
@@ -456,33 +993,100 @@ void VertexIndexToShape::extractV2SubMeshVertexBuffer(size_t& subMeshOffset,
 	VertexArrayObject::ReadRequestsArray requests,
 	const size_t& prevSize)
 {
+	BTOGRE_PROFILE_ZONE(V2VertexData);
 	auto subMeshVerticiesNum = requests[0].vertexBuffer->getNumElements();
-	switch (requests[0].type)
+	writePositions(reinterpret_cast<const unsigned char*>(requests[0].data),
+		requests[0].vertexBuffer->getBytesPerElement(),
+		requests[0].type,
+		subMeshVerticiesNum,
+		prevSize + subMeshOffset);
+	subMeshOffset += subMeshVerticiesNum;
+}
+
+void VertexIndexToShape::writePositions(const unsigned char* data, size_t stride, VertexElementType format, size_t count, size_t destination)
+{
+	BTOGRE_PROFILE_ZONE(VertexTransform);
+	BTOGRE_PROFILE_COUNT(VerticesProcessed, count);
+
+	auto output = mVertexBuffer.data() + destination;
+
+	//Most transforms are affine, this avoid a division per vertex. Identity can skip the transform entirely
+	const auto identity = mTransform == Matrix4::IDENTITY;
+	const auto affine = mTransform.isAffine();
+	const auto transform = [&](const Vector3& position)
+	{
+		return identity ? position : (affine ? mTransform.transformAffine(position) : mTransform * position);
+	};
+
+	switch (format)
 	{
 	case VET_HALF4:
-		for (size_t i = 0; i < subMeshVerticiesNum; ++i)
+		for (size_t i = 0; i < count; ++i)
 		{
-			auto pos = reinterpret_cast<const uint16*>(requests[0].data);	//Stored as 16 bits. Need to use Ogre::Bitwise utilities to extract a floating point form this
-			requests[0].data += requests[0].vertexBuffer->getBytesPerElement();
-			mVertexBuffer[prevSize + i + subMeshOffset] = mTransform * Vector3{ Bitwise::halfToFloat(pos[0]), Bitwise::halfToFloat(pos[1]), Bitwise::halfToFloat(pos[2]) };
+			auto pos = reinterpret_cast<const uint16*>(data + i * stride);	//Stored as 16 bits. Need to use Ogre::Bitwise utilities to extract a floating point form this
+			output[i] = transform(Vector3{ Bitwise::halfToFloat(pos[0]), Bitwise::halfToFloat(pos[1]), Bitwise::halfToFloat(pos[2]) });
 		}
 		break;
 	case VET_FLOAT3:
-		for (size_t i = 0; i < subMeshVerticiesNum; ++i)
+	case VET_FLOAT4:
+		for (size_t i = 0; i < count; ++i)
 		{
-			auto pos = reinterpret_cast<const Real*>(requests[0].data);
-			requests[0].data += requests[0].vertexBuffer->getBytesPerElement();
-			mVertexBuffer[prevSize + i + subMeshOffset] = mTransform * Vector3(pos);
+			auto pos = reinterpret_cast<const float*>(data + i * stride);
+			output[i] = transform(Vector3{ pos[0], pos[1], pos[2] });
+		}
+		break;
+	case VET_DOUBLE3:
+	case VET_DOUBLE4:
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto pos = reinterpret_cast<const double*>(data + i * stride);
+			output[i] = transform(Vector3{ Real(pos[0]), Real(pos[1]), Real(pos[2]) });
 		}
 		break;
 	default:
 		log("Error: Vertex Buffer type not recognised");
 	}
-	subMeshOffset += subMeshVerticiesNum;
+}
+
+void VertexIndexToShape::addRawGeometry(const void* positions, size_t stride, VertexElementType format, size_t count,
+	const void* indices, IndexBufferPacked::IndexType indexType, size_t indexCount,
+	const Matrix4& transform)
+{
+	//Checked before anything is touched, the buffers stay as they were
+	if (format != VET_FLOAT3 && format != VET_FLOAT4 && format != VET_HALF4 && format != VET_DOUBLE3 && format != VET_DOUBLE4)
+		throw std::invalid_argument("VertexIndexToShape::addRawGeometry : unsupported position format " + std::to_string(format));
+
+	mBounds = Vector3(-1, -1, -1);
+	mBoundRadius = -1;
+	mTransform = transform;
+
+	const auto vertexOffset = mVertexBuffer.size();
+	mVertexBuffer.resize(vertexOffset + count);
+	writePositions(static_cast<const unsigned char*>(positions), stride, format, count, vertexOffset);
+
+	const auto previousIndexSize = mIndexBuffer.size();
+	if (indices)
+	{
+		mIndexBuffer.resize(previousIndexSize + indexCount);
+		if (indexType == IndexBufferPacked::IT_32BIT)
+			writeIndices(static_cast<const uint32*>(indices), indexCount, previousIndexSize, vertexOffset);
+		else
+			writeIndices(static_cast<const uint16*>(indices), indexCount, previousIndexSize, vertexOffset);
+	}
+	else
+	{
+		//Unindexed triangle list
+		mIndexBuffer.resize(previousIndexSize + count);
+		for (auto i = size_t{ 0U }; i < count; ++i)
+			mIndexBuffer[previousIndexSize + i] = static_cast<unsigned>(vertexOffset + i);
+	}
+
+	tagSubMeshTriangles(BLANKSTRING, nullptr);
 }
 
 void VertexIndexToShape::requestV2VertexBufferFromVao(VertexArrayObject* vao, VertexArrayObject::ReadRequestsArray& requests)
 {
+	BTOGRE_PROFILE_ZONE(BufferMapping);
 	requests.push_back(VertexArrayObject::ReadRequests(VES_POSITION));
 
 	vao->readRequests(requests);
@@ -511,13 +1115,29 @@ void StaticMeshToShapeConverter::addItem(Item* item, const Matrix4& transform)
 
 void StaticMeshToShapeConverter::addMesh(const Mesh* mesh, const Matrix4& transform)
 {
-	mBounds = Vector3{ -1, -1, -1 };
-	mBoundRadius = -1;
-	mTransform = transform;
-
 	if (mesh->hasSkeleton())
 		log("MeshToShapeConverter::addMesh : Mesh " + mesh->getName() + " as skeleton but added to trimesh non animated");
 
+	//Datablocks can only be known if the mesh comes from the stored item
+	const auto item = mItem && mItem->getMesh().get() == mesh ? mItem : nullptr;
+
+	//Aabb::BOX_NULL and BOX_INFINITE have infinite half sizes, that would give NaN corners. They are mapped to their AxisAlignedBox extents explicitly
+	const auto& aabb = mesh->getAabb();
+	const auto& halfSize = aabb.mHalfSize;
+	const auto isNull = halfSize.x < 0 || halfSize.y < 0 || halfSize.z < 0;
+	const auto isInfinite = std::isinf(halfSize.x) || std::isinf(halfSize.y) || std::isinf(halfSize.z);
+
+	auto bounds = AxisAlignedBox::BOX_INFINITE;
+	if (isNull) bounds = AxisAlignedBox::BOX_NULL;
+	else if (!isInfinite) bounds.setExtents(aabb.getMinimum(), aabb.getMaximum());
+
+	deferMesh({ mesh, nullptr, item, nullptr, transform }, bounds);
+}
+
+void StaticMeshToShapeConverter::extractMesh(const Mesh* mesh, const Matrix4& transform, Item* item)
+{
+	mTransform = transform;
+
 	//Theses variables will hold the current size of this buffer
 	size_t prevVertexSize;
 	size_t prevIndexSize;
@@ -527,17 +1147,26 @@ void StaticMeshToShapeConverter::addMesh(const Mesh* mesh, const Matrix4& transf
 	getV2MeshBufferSize(mesh, prevVertexSize, prevIndexSize);
 
 	//The number to offset the index values. When switching submeshes, we want to append the indexes when reconstructing the full thing.
-	auto indexOffset = mIndexBuffer.empty() ? 0U : mIndexBuffer[mIndexBuffer.size() - 1];
+	auto indexOffset = static_cast<unsigned>(prevVertexSize);
 
 	//The offset associated with the current submesh
 	size_t subMeshOffset = 0U;
 
+	size_t subMeshIndex = 0U;
+
 	//For each submeshes
 	for (const auto& subMesh : mesh->getSubMeshes())
 	{
-		//Get VAO, go to next if submesh empty
+		const auto datablock = item ? item->getSubItem(subMeshIndex)->getDatablock() : nullptr;
+		++subMeshIndex;
+
+		//Get VAO, go to next if submesh empty. It's still registered, so the next submeshes keep their index
 		const auto vaos = subMesh->mVao[0];
-		if (vaos.empty()) continue;
+		if (vaos.empty())
+		{
+			tagSubMeshTriangles(subMesh->mMaterialName, datablock, (prevIndexSize + appendedIndexes) / 3);
+			continue;
+		}
 
 		//Get the first LOD level
 		const auto vao = vaos[0];
@@ -565,6 +1194,9 @@ void StaticMeshToShapeConverter::addMesh(const Mesh* mesh, const Matrix4& transf
 		//offset the index values by the number of vertex we got from that VAO
 		indexOffset += unsigned(vertexBuffers[0]->getNumElements());
 		appendedIndexes += indexBuffer[0].getNumElements();
+
+		//The index buffer already has the size of the whole mesh: only tag what this submesh appended
+		tagSubMeshTriangles(subMesh->mMaterialName, datablock, (prevIndexSize + appendedIndexes) / 3);
 	}
 }
 
@@ -637,6 +1269,8 @@ void AnimatedMeshToShapeConverter::addEntity(v1::Entity *entity, const Matrix4 &
 		{
 			appendV1IndexData(sub_mesh->indexData[0]);
 		}
+
+		tagSubMeshTriangles(sub_mesh->getMaterialName(), mEntity->getSubEntity(i)->getDatablock());
 	}
 
 	mEntity->removeSoftwareAnimationRequest(false);
@@ -675,6 +1309,8 @@ void AnimatedMeshToShapeConverter::addMesh(const v1::MeshPtr &mesh, const Matrix
 		{
 			appendV1IndexData(sub_mesh->indexData[0]);
 		}
+
+		tagSubMeshTriangles(sub_mesh->getMaterialName(), nullptr);
 	}
 }
 
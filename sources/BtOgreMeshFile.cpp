@@ -0,0 +1,616 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreMeshFile.cpp
+ *
+ *    Description:  BtOgre mesh file reader implementation.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreMeshFile.h"
+
+#include <OgreBitwise.h>
+#include <OgreHardwareVertexBuffer.h>
+#include <Vao/OgreVertexElements.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	///Chunk identifiers of the v1 mesh serializer, as in OgreMeshFileFormat.h
+	enum MeshChunkID : uint16
+	{
+		M_HEADER = 0x1000,
+		M_MESH = 0x3000,
+		M_SUBMESH = 0x4000,
+		M_SUBMESH_OPERATION = 0x4010,
+		M_SUBMESH_BONE_ASSIGNMENT = 0x4100,
+		M_SUBMESH_TEXTURE_ALIAS = 0x4200,
+		M_GEOMETRY = 0x5000,
+		M_GEOMETRY_VERTEX_DECLARATION = 0x5100,
+		M_GEOMETRY_VERTEX_ELEMENT = 0x5110,
+		M_GEOMETRY_VERTEX_BUFFER = 0x5200,
+		M_GEOMETRY_VERTEX_BUFFER_DATA = 0x5210,
+		M_MESH_SKELETON_LINK = 0x6000
+	};
+
+	///Values stored in the file for the few vertex element types, semantics and operations we care about
+	enum MeshFileValue : uint16
+	{
+		FILE_VET_FLOAT3 = 2,
+		FILE_VET_FLOAT4 = 3,
+		FILE_VES_POSITION = 1,
+		FILE_OT_TRIANGLE_LIST = 4,
+		FILE_OT_TRIANGLE_STRIP = 5,
+		FILE_OT_TRIANGLE_FAN = 6
+	};
+
+	///Size of the id + length header in front of each chunk
+	constexpr size_t chunkHeaderSize{ sizeof(uint16) + sizeof(uint32) };
+
+	///Revisions of the v2 mesh serializer, as written in the header of the file
+	enum MeshV2Revision
+	{
+		MESH_V2_R0,
+		MESH_V2_R1,
+		MESH_V2_R2,
+		MESH_V2_UNKNOWN
+	};
+
+	///Find the v2 revision named by a header version string
+	MeshV2Revision getV2Revision(const String& version)
+	{
+		if (version == "[MeshSerializer_v2.1]") return MESH_V2_R0;
+		if (version == "[MeshSerializer_v2.1 R1]") return MESH_V2_R1;
+		if (version == "[MeshSerializer_v2.1 R2]") return MESH_V2_R2;
+		return MESH_V2_UNKNOWN;
+	}
+
+	///Read position in the file, take care of the byte order the file was written in
+	class MeshFileCursor
+	{
+	public:
+		MeshFileCursor(const unsigned char* data, size_t size) :
+			mData(data),
+			mSize(size),
+			mPosition(0),
+			mSwap(false)
+		{
+		}
+
+		void setSwap(bool swap) { mSwap = swap; }
+		bool swapped() const { return mSwap; }
+		bool eof() const { return mPosition >= mSize; }
+		size_t tell() const { return mPosition; }
+
+		void seek(size_t position)
+		{
+			if (position > mSize) throw std::runtime_error("BtOgre mesh file reader : unexpected end of file");
+			mPosition = position;
+		}
+
+		void skip(size_t bytes) { seek(mPosition + bytes); }
+
+		const unsigned char* read(size_t bytes)
+		{
+			const auto start = mData + mPosition;
+			skip(bytes);
+			return start;
+		}
+
+		template <typename T> T readValue()
+		{
+			unsigned char bytes[sizeof(T)];
+			std::memcpy(bytes, read(sizeof(T)), sizeof(T));
+			if (mSwap) std::reverse(std::begin(bytes), std::end(bytes));
+
+			T value;
+			std::memcpy(&value, bytes, sizeof(T));
+			return value;
+		}
+
+		bool readBool() { return *read(1) != 0; }
+
+		///Strings are terminated by a new line
+		String readString()
+		{
+			String string;
+			while (!eof())
+			{
+				const auto c = static_cast<char>(*read(1));
+				if (c == '\n') break;
+				string += c;
+			}
+			return string;
+		}
+
+		///Read a chunk header, return the chunk id and set its total length (header included)
+		uint16 readChunk(uint32& length)
+		{
+			const auto id = readValue<uint16>();
+			length = readValue<uint32>();
+			return id;
+		}
+
+		///Go back before a chunk header that belong to an enclosing level
+		void backpedalChunk() { mPosition -= chunkHeaderSize; }
+
+		///Get the end of a chunk that started at start, after checking its length covers its header and fits in its parent chunk and in the file
+		size_t chunkEnd(size_t start, uint32 length, size_t parentEnd) const
+		{
+			if (length < chunkHeaderSize)
+				throw std::runtime_error("BtOgre mesh file reader : chunk length " + std::to_string(length) + " is smaller than a chunk header");
+			if (start + length > std::min(parentEnd, mSize))
+				throw std::runtime_error("BtOgre mesh file reader : chunk length " + std::to_string(length) + " goes past its parent chunk or the end of the file");
+			return start + length;
+		}
+
+		///Go to the end of a chunk that started at start
+		void skipChunk(size_t start, uint32 length, size_t parentEnd) { seek(chunkEnd(start, length, parentEnd)); }
+
+	private:
+		const unsigned char* mData;
+		size_t mSize;
+		size_t mPosition;
+		bool mSwap;
+	};
+
+	///Read a M_GEOMETRY chunk content, only keep the positions
+	void readGeometry(MeshFileCursor& cursor, std::vector<Vector3>& positions)
+	{
+		const auto vertexCount = cursor.readValue<uint32>();
+
+		//Position element description
+		auto positionSource = uint16{ 0 };
+		auto positionType = uint16{ 0 };
+		auto positionOffset = uint16{ 0 };
+		auto hasPosition = false;
+
+		while (!cursor.eof())
+		{
+			uint32 length;
+			const auto id = cursor.readChunk(length);
+
+			if (id == M_GEOMETRY_VERTEX_DECLARATION)
+			{
+				while (!cursor.eof())
+				{
+					const auto elementId = cursor.readChunk(length);
+					if (elementId != M_GEOMETRY_VERTEX_ELEMENT)
+					{
+						cursor.backpedalChunk();
+						break;
+					}
+
+					const auto source = cursor.readValue<uint16>();
+					const auto type = cursor.readValue<uint16>();
+					const auto semantic = cursor.readValue<uint16>();
+					const auto offset = cursor.readValue<uint16>();
+					const auto index = cursor.readValue<uint16>();
+
+					if (semantic == FILE_VES_POSITION && index == 0)
+					{
+						positionSource = source;
+						positionType = type;
+						positionOffset = offset;
+						hasPosition = true;
+					}
+				}
+			}
+			else if (id == M_GEOMETRY_VERTEX_BUFFER)
+			{
+				const auto bindIndex = cursor.readValue<uint16>();
+				const auto vertexSize = cursor.readValue<uint16>();
+
+				if (cursor.readChunk(length) != M_GEOMETRY_VERTEX_BUFFER_DATA)
+					throw std::runtime_error("BtOgre mesh file reader : vertex buffer without data");
+
+				const auto data = cursor.read(size_t(vertexCount) * vertexSize);
+				if (!hasPosition || bindIndex != positionSource) continue;
+
+				if (positionType != FILE_VET_FLOAT3 && positionType != FILE_VET_FLOAT4)
+					throw std::runtime_error("BtOgre mesh file reader : unsupported vertex position type " + std::to_string(positionType));
+
+				//Positions are floats, in the byte order of the file
+				positions.resize(vertexCount);
+				MeshFileCursor vertexCursor(data, size_t(vertexCount) * vertexSize);
+				vertexCursor.setSwap(cursor.swapped());
+				for (auto i = size_t{ 0U }; i < vertexCount; ++i)
+				{
+					vertexCursor.seek(i * vertexSize + positionOffset);
+					positions[i].x = vertexCursor.readValue<float>();
+					positions[i].y = vertexCursor.readValue<float>();
+					positions[i].z = vertexCursor.readValue<float>();
+				}
+			}
+			else
+			{
+				cursor.backpedalChunk();
+				break;
+			}
+		}
+	}
+
+	///Turn strips and fans into lists
+	void toTriangleList(std::vector<unsigned int>& indices, uint16 operation)
+	{
+		if (operation == FILE_OT_TRIANGLE_LIST || indices.size() < 3) return;
+
+		std::vector<unsigned int> list;
+		list.reserve(3 * (indices.size() - 2));
+		for (auto i = size_t{ 2U }; i < indices.size(); ++i)
+		{
+			if (operation == FILE_OT_TRIANGLE_FAN)
+				list.insert(list.end(), { indices[0], indices[i - 1], indices[i] });
+			//Every other triangle of a strip has the opposite winding
+			else if (i % 2 == 0)
+				list.insert(list.end(), { indices[i - 2], indices[i - 1], indices[i] });
+			else
+				list.insert(list.end(), { indices[i - 1], indices[i - 2], indices[i] });
+		}
+		indices.swap(list);
+	}
+
+	///Read a M_SUBMESH chunk content ending at end, and the chunks that belong to it. Shared vertices have to be read first
+	MeshFileSubMesh readSubMesh(MeshFileCursor& cursor, size_t end, size_t sharedVertexCount)
+	{
+		MeshFileSubMesh subMesh;
+		subMesh.materialName = cursor.readString();
+		subMesh.useSharedVertices = cursor.readBool();
+
+		const auto indexCount = cursor.readValue<uint32>();
+		const auto indices32 = cursor.readBool();
+		subMesh.indices.resize(indexCount);
+		for (auto& index : subMesh.indices)
+			index = indices32 ? cursor.readValue<uint32>() : cursor.readValue<uint16>();
+
+		if (!subMesh.useSharedVertices)
+		{
+			uint32 length;
+			if (cursor.readChunk(length) != M_GEOMETRY)
+				throw std::runtime_error("BtOgre mesh file reader : submesh without shared vertices has no geometry");
+			readGeometry(cursor, subMesh.vertices);
+		}
+
+		//Indices are used to read the positions, they can't be trusted
+		const auto vertexCount = subMesh.useSharedVertices ? sharedVertexCount : subMesh.vertices.size();
+		const auto maxIndex = std::max_element(subMesh.indices.begin(), subMesh.indices.end());
+		if (maxIndex != subMesh.indices.end() && *maxIndex >= vertexCount)
+			throw std::runtime_error("BtOgre mesh file reader : submesh index " + std::to_string(*maxIndex) + " is out of its " + std::to_string(vertexCount) + " vertices");
+
+		auto operation = uint16{ FILE_OT_TRIANGLE_LIST };
+		while (cursor.tell() < end)
+		{
+			uint32 length;
+			const auto start = cursor.tell();
+			const auto id = cursor.readChunk(length);
+
+			if (id == M_SUBMESH_OPERATION)
+				operation = cursor.readValue<uint16>();
+			else if (id == M_SUBMESH_BONE_ASSIGNMENT || id == M_SUBMESH_TEXTURE_ALIAS)
+				cursor.skipChunk(start, length, end);
+			else
+			{
+				cursor.backpedalChunk();
+				break;
+			}
+		}
+
+		if (operation != FILE_OT_TRIANGLE_LIST && operation != FILE_OT_TRIANGLE_STRIP && operation != FILE_OT_TRIANGLE_FAN)
+			subMesh.indices.clear();
+		else
+			toTriangleList(subMesh.indices, operation);
+
+		return subMesh;
+	}
+
+	///Read a v2 M_GEOMETRY chunk content ending at end, only keep the positions.
+	///v2 geometry stores the vertex element types and semantics of Ogre 2, and packs the elements of each source without offsets
+	void readGeometryV2(MeshFileCursor& cursor, size_t end, std::vector<Vector3>& positions)
+	{
+		const auto vertexCount = cursor.readValue<uint32>();
+		const auto sourceCount = size_t(cursor.read(1)[0]);
+
+		uint32 length;
+		auto start = cursor.tell();
+		if (cursor.readChunk(length) != M_GEOMETRY_VERTEX_DECLARATION)
+			throw std::runtime_error("BtOgre mesh file reader : v2 geometry without vertex declaration");
+		const auto declarationEnd = cursor.chunkEnd(start, length, end);
+
+		//Position element description
+		auto positionSource = sourceCount;
+		auto positionType = VET_FLOAT3;
+		auto positionOffset = size_t{ 0U };
+
+		for (auto source = size_t{ 0U }; source < sourceCount; ++source)
+		{
+			const auto elementCount = size_t(cursor.read(1)[0]);
+			auto offset = size_t{ 0U };
+			for (auto element = size_t{ 0U }; element < elementCount; ++element)
+			{
+				const auto type = static_cast<VertexElementType>(cursor.read(1)[0]);
+				const auto semantic = static_cast<VertexElementSemantic>(cursor.read(1)[0]);
+
+				if (semantic == VES_POSITION && positionSource == sourceCount)
+				{
+					positionSource = source;
+					positionType = type;
+					positionOffset = offset;
+				}
+				offset += v1::VertexElement::getTypeSize(type);
+			}
+		}
+		cursor.seek(declarationEnd);
+
+		for (auto source = size_t{ 0U }; source < sourceCount; ++source)
+		{
+			start = cursor.tell();
+			if (cursor.readChunk(length) != M_GEOMETRY_VERTEX_BUFFER)
+				throw std::runtime_error("BtOgre mesh file reader : v2 geometry is missing a vertex buffer");
+			const auto bufferEnd = cursor.chunkEnd(start, length, end);
+
+			const auto bindIndex = size_t(cursor.read(1)[0]);
+			const auto vertexSize = size_t(cursor.read(1)[0]);
+
+			if (cursor.readChunk(length) != M_GEOMETRY_VERTEX_BUFFER_DATA)
+				throw std::runtime_error("BtOgre mesh file reader : vertex buffer without data");
+			const auto data = cursor.read(size_t(vertexCount) * vertexSize);
+			cursor.seek(bufferEnd);
+
+			if (bindIndex != positionSource) continue;
+
+			const auto positionSize = v1::VertexElement::getTypeSize(positionType);
+			if (positionOffset + positionSize > vertexSize)
+				throw std::runtime_error("BtOgre mesh file reader : vertex position goes past its vertex");
+
+			//Positions are in the byte order of the file
+			positions.resize(vertexCount);
+			MeshFileCursor vertexCursor(data, size_t(vertexCount) * vertexSize);
+			vertexCursor.setSwap(cursor.swapped());
+			for (auto i = size_t{ 0U }; i < vertexCount; ++i)
+			{
+				vertexCursor.seek(i * vertexSize + positionOffset);
+				switch (positionType)
+				{
+				case VET_FLOAT3:
+				case VET_FLOAT4:
+					positions[i].x = vertexCursor.readValue<float>();
+					positions[i].y = vertexCursor.readValue<float>();
+					positions[i].z = vertexCursor.readValue<float>();
+					break;
+				case VET_DOUBLE3:
+				case VET_DOUBLE4:
+					positions[i].x = Real(vertexCursor.readValue<double>());
+					positions[i].y = Real(vertexCursor.readValue<double>());
+					positions[i].z = Real(vertexCursor.readValue<double>());
+					break;
+				case VET_HALF4:
+					positions[i].x = Bitwise::halfToFloat(vertexCursor.readValue<uint16>());
+					positions[i].y = Bitwise::halfToFloat(vertexCursor.readValue<uint16>());
+					positions[i].z = Bitwise::halfToFloat(vertexCursor.readValue<uint16>());
+					break;
+				default:
+					throw std::runtime_error("BtOgre mesh file reader : unsupported vertex position type " + std::to_string(positionType));
+				}
+			}
+		}
+
+		if (positionSource == sourceCount)
+			throw std::runtime_error("BtOgre mesh file reader : v2 geometry without vertex positions");
+	}
+
+	///Read the content of the index buffer chunk of a v2 submesh LOD
+	void readIndexBufferV2(MeshFileCursor& cursor, std::vector<unsigned int>& indices)
+	{
+		const auto indexCount = cursor.readValue<uint32>();
+		if (!indexCount) return;
+
+		//0 for 16 bit indices, 1 for 32 bit ones
+		const auto indices32 = cursor.read(1)[0] != 0;
+		indices.resize(indexCount);
+		for (auto& index : indices)
+			index = indices32 ? cursor.readValue<uint32>() : cursor.readValue<uint16>();
+	}
+
+	///Read a v2 M_SUBMESH chunk content ending at end. Only the first LOD of the first VAO pass is read, the full detail geometry.
+	///The LOD chunk holds the LOD it takes its vertices from, the M_GEOMETRY chunk when it's its own, then the index buffer chunk
+	MeshFileSubMesh readSubMeshV2(MeshFileCursor& cursor, size_t end)
+	{
+		MeshFileSubMesh subMesh;
+		subMesh.materialName = cursor.readString();
+		subMesh.useSharedVertices = false;
+
+		const auto lodCount = cursor.read(1)[0];
+		if (!lodCount) return subMesh;
+
+		uint32 length;
+		const auto lodStart = cursor.tell();
+		cursor.readChunk(length);
+		const auto lodEnd = cursor.chunkEnd(lodStart, length, end);
+
+		//The first LOD can't share the vertices of another one
+		if (cursor.read(1)[0] != 0)
+			throw std::runtime_error("BtOgre mesh file reader : first LOD of a v2 submesh without its own vertices");
+
+		auto start = cursor.tell();
+		if (cursor.readChunk(length) != M_GEOMETRY)
+			throw std::runtime_error("BtOgre mesh file reader : v2 submesh without geometry");
+		readGeometryV2(cursor, cursor.chunkEnd(start, length, lodEnd), subMesh.vertices);
+		cursor.skipChunk(start, length, lodEnd);
+
+		start = cursor.tell();
+		cursor.readChunk(length);
+		const auto indexEnd = cursor.chunkEnd(start, length, lodEnd);
+		readIndexBufferV2(cursor, subMesh.indices);
+		if (cursor.tell() > indexEnd)
+			throw std::runtime_error("BtOgre mesh file reader : v2 index buffer goes past its chunk");
+
+		//v2 submeshes are triangle lists, the indices are used to read the positions, they can't be trusted
+		const auto maxIndex = std::max_element(subMesh.indices.begin(), subMesh.indices.end());
+		if (maxIndex != subMesh.indices.end() && *maxIndex >= subMesh.vertices.size())
+			throw std::runtime_error("BtOgre mesh file reader : submesh index " + std::to_string(*maxIndex) + " is out of its " + std::to_string(subMesh.vertices.size()) + " vertices");
+		subMesh.indices.resize(subMesh.indices.size() - subMesh.indices.size() % 3);
+
+		//The other LODs, shadow mapping passes, bone assignments... aren't needed for collisions
+		cursor.seek(end);
+		return subMesh;
+	}
+
+	///Read a v2 M_MESH chunk content ending at end
+	void readMeshV2(MeshFileCursor& cursor, size_t end, MeshV2Revision revision, std::vector<MeshFileSubMesh>& subMeshes, bool& hasSkeleton)
+	{
+		//skeletally animated flag, the skeleton link chunk is what matters
+		cursor.readBool();
+
+		//Number of VAO passes (R1) and the hash used by the shader caches (R2)
+		if (revision >= MESH_V2_R1) cursor.skip(1);
+		if (revision >= MESH_V2_R2) cursor.skip(2 * sizeof(uint64));
+
+		//LOD strategy and values
+		cursor.readString();
+		const auto lodValueCount = cursor.readValue<uint16>();
+		cursor.skip(lodValueCount * sizeof(float));
+
+		while (cursor.tell() < end)
+		{
+			uint32 length;
+			const auto chunkStart = cursor.tell();
+			const auto chunkId = cursor.readChunk(length);
+			const auto chunkEnd = cursor.chunkEnd(chunkStart, length, end);
+
+			if (chunkId == M_SUBMESH)
+				subMeshes.push_back(readSubMeshV2(cursor, chunkEnd));
+			else if (chunkId == M_MESH_SKELETON_LINK)
+				hasSkeleton = true;
+
+			//Bounds, submesh names... aren't needed for collisions
+			cursor.seek(chunkEnd);
+		}
+	}
+}
+
+MeshFileReader::MeshFileReader(const String& path) :
+	mHasSkeleton(false)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) throw std::runtime_error("BtOgre mesh file reader : cannot open " + path);
+
+	const std::vector<unsigned char> content{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	parse(content.data(), content.size());
+}
+
+MeshFileReader::MeshFileReader(DataStreamPtr stream) :
+	mHasSkeleton(false)
+{
+	std::vector<unsigned char> content(stream->size());
+	content.resize(stream->read(content.data(), content.size()));
+	parse(content.data(), content.size());
+}
+
+MeshFileReader::MeshFileReader(const unsigned char* data, size_t size) :
+	mHasSkeleton(false)
+{
+	parse(data, size);
+}
+
+void MeshFileReader::parse(const unsigned char* data, size_t size)
+{
+	MeshFileCursor cursor(data, size);
+
+	//The header id tell us the byte order the file was written in
+	const auto header = cursor.readValue<uint16>();
+	if (header != M_HEADER)
+	{
+		cursor.setSwap(true);
+		cursor.seek(0);
+		if (cursor.readValue<uint16>() != M_HEADER)
+			throw std::runtime_error("BtOgre mesh file reader : not an Ogre mesh file");
+	}
+
+	//v2 files name their revision in the header, the layout depends on it
+	mVersion = cursor.readString();
+	const auto isV1 = mVersion.find("[MeshSerializer_v1.") == 0;
+	const auto v2Revision = getV2Revision(mVersion);
+	if (!isV1 && v2Revision == MESH_V2_UNKNOWN)
+		throw std::runtime_error("BtOgre mesh file reader : unsupported mesh format " + mVersion);
+
+	while (!cursor.eof())
+	{
+		uint32 length;
+		const auto start = cursor.tell();
+		const auto id = cursor.readChunk(length);
+
+		if (id != M_MESH)
+		{
+			cursor.skipChunk(start, length, size);
+			continue;
+		}
+		const auto meshEnd = cursor.chunkEnd(start, length, size);
+
+		if (!isV1)
+		{
+			readMeshV2(cursor, meshEnd, v2Revision, mSubMeshes, mHasSkeleton);
+			continue;
+		}
+
+		//skeletally animated flag, the skeleton link chunk is what matters
+		cursor.readBool();
+
+		while (cursor.tell() < meshEnd)
+		{
+			const auto chunkStart = cursor.tell();
+			const auto chunkId = cursor.readChunk(length);
+
+			switch (chunkId)
+			{
+			case M_GEOMETRY:
+				readGeometry(cursor, mSharedVertices);
+				break;
+			case M_SUBMESH:
+				mSubMeshes.push_back(readSubMesh(cursor, cursor.chunkEnd(chunkStart, length, meshEnd), mSharedVertices.size()));
+				break;
+			case M_MESH_SKELETON_LINK:
+				mHasSkeleton = true;
+				cursor.skipChunk(chunkStart, length, meshEnd);
+				break;
+			default:
+				//LODs, bounds, edge lists, animations, poses... aren't needed for collisions
+				cursor.skipChunk(chunkStart, length, meshEnd);
+				break;
+			}
+		}
+	}
+}
+
+const String& MeshFileReader::getVersion() const
+{
+	return mVersion;
+}
+
+const std::vector<Vector3>& MeshFileReader::getSharedVertices() const
+{
+	return mSharedVertices;
+}
+
+const std::vector<MeshFileSubMesh>& MeshFileReader::getSubMeshes() const
+{
+	return mSubMeshes;
+}
+
+bool MeshFileReader::hasSkeleton() const
+{
+	return mHasSkeleton;
+}
@@ -1,4 +1,12 @@
 #include "BtOgrePG.h"
+#include "BtOgreProfiling.h"
+
+#include <OgreSceneManager.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
 
 using namespace Ogre;
 using namespace BtOgre;
@@ -31,9 +39,16 @@ void RigidBodyState::setWorldTransformNoUpdate(const btTransform& in)
 	mTransform = in;
 }
 
+void RigidBodyState::shiftOrigin(const btVector3& offset)
+{
+	mTransform.getOrigin() -= offset;
+}
+
 void RigidBodyState::setWorldTransform(const btTransform& in)
 {
 	if (!mNode) return;
+	BTOGRE_PROFILE_ZONE(MotionStateSync);
+	BTOGRE_PROFILE_COUNT(NodesWritten, 1);
 
 	//store transform
 	mTransform = in;
@@ -67,3 +82,558 @@ btVector3 RigidBodyState::getOffset() const
 {
 	return mCenterOfMassOffset.getOrigin();
 }
+
+void DeferredTransformQueue::push(DeferredRigidBodyState* state, SceneNode* node, const Vector3& position, const Quaternion& orientation)
+{
+	mWriteBuffer[state->mQueueIndex] = { node, position, orientation, true };
+}
+
+void DeferredTransformQueue::publish()
+{
+	//The slots the render thread hasn't applied yet are overwritten, the latest pose wins
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (auto i = size_t{ 0U }; i < mWriteBuffer.size(); ++i)
+	{
+		auto& written = mWriteBuffer[i];
+		if (!written.pending) continue;
+
+		mPendingBuffer[i] = written;
+		written.pending = false;
+	}
+}
+
+void DeferredTransformQueue::applyPendingTransforms()
+{
+	{
+		//mApplyBuffer had all its slots applied, it becomes the next pending buffer
+		std::lock_guard<std::mutex> lock(mMutex);
+		mApplyBuffer.swap(mPendingBuffer);
+	}
+
+	BTOGRE_PROFILE_ZONE(MotionStateSync);
+
+	auto written = size_t{ 0U };
+	for (auto& pending : mApplyBuffer)
+	{
+		if (!pending.pending) continue;
+
+		pending.node->_setDerivedOrientation(pending.orientation);
+		pending.node->_setDerivedPosition(pending.position);
+		pending.pending = false;
+		++written;
+	}
+
+	BTOGRE_PROFILE_COUNT(NodesWritten, written);
+}
+
+void DeferredTransformQueue::clear()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (auto buffer : { &mWriteBuffer, &mPendingBuffer, &mApplyBuffer })
+		for (auto& slot : *buffer)
+			slot.pending = false;
+}
+
+void DeferredTransformQueue::addState(DeferredRigidBodyState* state)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	state->mQueueIndex = mStates.size();
+	mStates.push_back(state);
+
+	const PendingTransform empty{ nullptr, Vector3::ZERO, Quaternion::IDENTITY, false };
+	mWriteBuffer.push_back(empty);
+	mPendingBuffer.push_back(empty);
+	mApplyBuffer.push_back(empty);
+}
+
+void DeferredTransformQueue::removeState(DeferredRigidBodyState* state)
+{
+	//Swap with the last one, the order doesn't matter
+	std::lock_guard<std::mutex> lock(mMutex);
+	const auto index = state->mQueueIndex;
+	mStates[index] = mStates.back();
+	mStates[index]->mQueueIndex = index;
+	mStates.pop_back();
+
+	for (auto buffer : { &mWriteBuffer, &mPendingBuffer, &mApplyBuffer })
+	{
+		(*buffer)[index] = buffer->back();
+		buffer->pop_back();
+	}
+}
+
+DeferredRigidBodyState::DeferredRigidBodyState(DeferredTransformQueue* queue, SceneNode* node, const btTransform& transform, const btTransform& offset) :
+	RigidBodyState(node, transform, offset),
+	mQueue(queue),
+	mQueueIndex(0)
+{
+	mQueue->addState(this);
+}
+
+DeferredRigidBodyState::DeferredRigidBodyState(DeferredTransformQueue* queue, SceneNode* node) :
+	RigidBodyState(node),
+	mQueue(queue),
+	mQueueIndex(0)
+{
+	mQueue->addState(this);
+}
+
+DeferredRigidBodyState::~DeferredRigidBodyState()
+{
+	mQueue->removeState(this);
+}
+
+FixedStepInterpolator::FixedStepInterpolator(btDiscreteDynamicsWorld* world, btScalar fixedTimeStep, int maxSubSteps) :
+	mWorld(world),
+	mFixedTimeStep(fixedTimeStep),
+	mMaxSubSteps(std::max(1, maxSubSteps)),
+	mAccumulator(0),
+	mLastStepTime(0),
+	mLastUpdateTime(0),
+	mStepCount(0)
+{
+	//The motion states must get the pose at the end of each step, not a pose extrapolated from it
+	mWorld->setLatencyMotionStateInterpolation(true);
+}
+
+int FixedStepInterpolator::update(btScalar frameTime)
+{
+	using clock = std::chrono::steady_clock;
+	const auto updateStart = clock::now();
+
+	mAccumulator += frameTime;
+
+	auto steps = 0;
+	while (mAccumulator >= mFixedTimeStep && steps < mMaxSubSteps)
+	{
+		++mStepCount;
+		const auto stepStart = clock::now();
+		{
+			BTOGRE_PROFILE_ZONE(Simulation);
+			//Without substeps Bullet does exactly one step of the given time, and gives the resulting poses to the motion states
+			mWorld->stepSimulation(mFixedTimeStep, 0);
+		}
+		mLastStepTime = std::chrono::duration<double, std::milli>(clock::now() - stepStart).count();
+
+		mAccumulator -= mFixedTimeStep;
+		++steps;
+	}
+
+	//Too far behind to catch up, drop the time instead of trying to do more and more steps each frame
+	if (steps == mMaxSubSteps)
+		mAccumulator = std::min(mAccumulator, mFixedTimeStep);
+
+	const auto alpha = getAlpha();
+	for (auto state : mStates)
+		state->interpolate(alpha);
+
+	mLastUpdateTime = std::chrono::duration<double, std::milli>(clock::now() - updateStart).count();
+	return steps;
+}
+
+void FixedStepInterpolator::setFixedTimeStep(btScalar fixedTimeStep)
+{
+	mFixedTimeStep = fixedTimeStep;
+}
+
+btScalar FixedStepInterpolator::getFixedTimeStep() const
+{
+	return mFixedTimeStep;
+}
+
+void FixedStepInterpolator::setMaxSubSteps(int maxSubSteps)
+{
+	mMaxSubSteps = std::max(1, maxSubSteps);
+}
+
+int FixedStepInterpolator::getMaxSubSteps() const
+{
+	return mMaxSubSteps;
+}
+
+btScalar FixedStepInterpolator::getAlpha() const
+{
+	return std::min(mAccumulator / mFixedTimeStep, btScalar(1));
+}
+
+double FixedStepInterpolator::getLastStepTime() const
+{
+	return mLastStepTime;
+}
+
+double FixedStepInterpolator::getLastUpdateTime() const
+{
+	return mLastUpdateTime;
+}
+
+unsigned long long FixedStepInterpolator::getStepCount() const
+{
+	return mStepCount;
+}
+
+void FixedStepInterpolator::addState(InterpolatedRigidBodyState* state)
+{
+	state->mInterpolatorIndex = mStates.size();
+	mStates.push_back(state);
+}
+
+void FixedStepInterpolator::removeState(InterpolatedRigidBodyState* state)
+{
+	//Swap with the last one, the order doesn't matter
+	const auto index = state->mInterpolatorIndex;
+	mStates[index] = mStates.back();
+	mStates[index]->mInterpolatorIndex = index;
+	mStates.pop_back();
+}
+
+InterpolatedRigidBodyState::InterpolatedRigidBodyState(FixedStepInterpolator* interpolator, SceneNode* node, const btTransform& transform, const btTransform& offset) :
+	RigidBodyState(node, transform, offset),
+	mInterpolator(interpolator),
+	mPreviousTransform(transform),
+	mStep(interpolator->getStepCount()),
+	mInterpolatorIndex(0)
+{
+	mInterpolator->addState(this);
+}
+
+InterpolatedRigidBodyState::InterpolatedRigidBodyState(FixedStepInterpolator* interpolator, SceneNode* node) :
+	RigidBodyState(node),
+	mInterpolator(interpolator),
+	mPreviousTransform(mTransform),
+	mStep(interpolator->getStepCount()),
+	mInterpolatorIndex(0)
+{
+	mInterpolator->addState(this);
+}
+
+InterpolatedRigidBodyState::~InterpolatedRigidBodyState()
+{
+	mInterpolator->removeState(this);
+}
+
+void InterpolatedRigidBodyState::setWorldTransform(const btTransform& in)
+{
+	mPreviousTransform = mTransform;
+	mTransform = in;
+	mStep = mInterpolator->getStepCount();
+}
+
+void InterpolatedRigidBodyState::shiftOrigin(const btVector3& offset)
+{
+	RigidBodyState::shiftOrigin(offset);
+	mPreviousTransform.getOrigin() -= offset;
+}
+
+void InterpolatedRigidBodyState::interpolate(btScalar alpha)
+{
+	if (!mNode) return;
+	BTOGRE_PROFILE_ZONE(MotionStateSync);
+	BTOGRE_PROFILE_COUNT(NodesWritten, 1);
+
+	//Not moved by the last step: nothing to interpolate from anymore
+	if (mStep != mInterpolator->getStepCount())
+		mPreviousTransform = mTransform;
+
+	const btTransform interpolated
+	{
+		mPreviousTransform.getRotation().slerp(mTransform.getRotation(), alpha),
+		mPreviousTransform.getOrigin().lerp(mTransform.getOrigin(), alpha)
+	};
+
+	const auto transform = interpolated * mCenterOfMassOffset;
+	mNode->_setDerivedOrientation(Convert::toOgre(transform.getRotation()));
+	mNode->_setDerivedPosition(Convert::toOgre(transform.getOrigin()));
+}
+
+size_t KinematicBodyDriver::update()
+{
+	for (auto state : mStates)
+		state->updateFromNode();
+
+	return mStates.size();
+}
+
+size_t KinematicBodyDriver::getStateCount() const
+{
+	return mStates.size();
+}
+
+void KinematicBodyDriver::addState(KinematicMotionState* state)
+{
+	state->mDriverIndex = mStates.size();
+	mStates.push_back(state);
+}
+
+void KinematicBodyDriver::removeState(KinematicMotionState* state)
+{
+	//Swap with the last one, the order doesn't matter
+	const auto index = state->mDriverIndex;
+	mStates[index] = mStates.back();
+	mStates[index]->mDriverIndex = index;
+	mStates.pop_back();
+}
+
+KinematicMotionState::KinematicMotionState(KinematicBodyDriver* driver, SceneNode* node, const btTransform& offset) :
+	mTransform
+	(
+		node ? Convert::toBullet(node->_getDerivedOrientationUpdated()) : btQuaternion(0, 0, 0, 1),
+		node ? Convert::toBullet(node->_getDerivedPositionUpdated()) : btVector3(0, 0, 0)
+	),
+	mCenterOfMassOffset(offset),
+	mNode(node),
+	mDriver(driver),
+	mDriverIndex(0)
+{
+	mTransform = mTransform * mCenterOfMassOffset.inverse();
+	if (mDriver) mDriver->addState(this);
+}
+
+KinematicMotionState::~KinematicMotionState()
+{
+	if (mDriver) mDriver->removeState(this);
+}
+
+void KinematicMotionState::getWorldTransform(btTransform& ret) const
+{
+	ret = mTransform;
+}
+
+void KinematicMotionState::setWorldTransform(const btTransform&)
+{
+}
+
+void KinematicMotionState::updateFromNode()
+{
+	if (!mNode) return;
+
+	//The cached values, no parent update is forced
+	const btTransform transform
+	{
+		Convert::toBullet(mNode->_getDerivedOrientation()),
+		Convert::toBullet(mNode->_getDerivedPosition())
+	};
+	mTransform = transform * mCenterOfMassOffset.inverse();
+}
+
+void KinematicMotionState::shiftOrigin(const btVector3& offset)
+{
+	mTransform.getOrigin() -= offset;
+}
+
+void KinematicMotionState::setNode(SceneNode* node)
+{
+	mNode = node;
+}
+
+SceneNode* KinematicMotionState::getNode() const
+{
+	return mNode;
+}
+
+BodySyncSystem::BodySyncSystem(btScalar linearEpsilon, btScalar angularEpsilon) :
+	mLinearEpsilon2(linearEpsilon * linearEpsilon),
+	//The columns of two rotation matrices an angle a apart are, squared and summed, about 2 * a^2 apart
+	mAngularEpsilon2(2 * angularEpsilon * angularEpsilon),
+	mStaticSleepingNodes(true),
+	mStaticNodeCount(0)
+{
+}
+
+void BodySyncSystem::addBody(btRigidBody* body, SceneNode* node, const btTransform& offset)
+{
+	if (mIndices.count(body)) throw std::runtime_error("BodySyncSystem::addBody : body already added");
+
+	const auto parent = node->getParentSceneNode();
+	const auto local = !parent || !parent->getParent();
+
+	mIndices[body] = mEntries.size();
+	mEntries.push_back({ body, node, offset, body->getWorldTransform(), true, local, node->isStatic() });
+	if (node->isStatic()) ++mStaticNodeCount;
+}
+
+void BodySyncSystem::removeBody(btRigidBody* body)
+{
+	const auto found = mIndices.find(body);
+	if (found == mIndices.end()) return;
+
+	//Swap with the last one to stay contiguous
+	const auto index = found->second;
+	mIndices.erase(found);
+	if (mEntries[index].isStatic) --mStaticNodeCount;
+	if (index != mEntries.size() - 1)
+	{
+		mEntries[index] = mEntries.back();
+		mIndices[mEntries[index].body] = index;
+	}
+	mEntries.pop_back();
+}
+
+size_t BodySyncSystem::synchronize()
+{
+	BTOGRE_PROFILE_ZONE(MotionStateSync);
+
+	//First pass only reads the bodies, to find the ones that moved
+	mMoved.clear();
+	for (auto i = size_t{ 0U }; i < mEntries.size(); ++i)
+	{
+		auto& entry = mEntries[i];
+		const auto active = entry.body->isActive();
+
+		//A body that just fell asleep gets its final pose written once, before its node is demoted
+		const auto demote = mStaticSleepingNodes && !active && !entry.isStatic;
+		if (!entry.force && !active && !demote) continue;
+
+		const auto& transform = entry.body->getWorldTransform();
+		if (!entry.force && !demote)
+		{
+			const auto& basis = transform.getBasis();
+			const auto& written = entry.written.getBasis();
+			const auto rotation = (basis[0] - written[0]).length2() + (basis[1] - written[1]).length2() + (basis[2] - written[2]).length2();
+			if ((transform.getOrigin() - entry.written.getOrigin()).length2() <= mLinearEpsilon2 && rotation <= mAngularEpsilon2) continue;
+		}
+
+		entry.written = transform;
+		entry.force = false;
+		mMoved.push_back(i);
+	}
+
+	//Second pass switches the nodes and writes the ones that can't take SoA writes, in the order of the entries
+	mSoAWrites.clear();
+	for (auto i : mMoved)
+	{
+		auto& entry = mEntries[i];
+		const auto sleeping = mStaticSleepingNodes && !entry.body->isActive();
+
+		//Switching a SceneNode also switches the objects attached to it
+		if (entry.isStatic && !sleeping)
+		{
+			entry.node->setStatic(false);
+			entry.isStatic = false;
+			--mStaticNodeCount;
+		}
+
+		const auto transform = entry.written * entry.offset;
+		const auto orientation = Convert::toOgre(transform.getRotation());
+		const auto position = Convert::toOgre(transform.getOrigin());
+
+		//Dynamic nodes in local space are written straight to their SoA slots once every switch is done, as a switch moves nodes in memory
+		if (entry.local && !entry.isStatic && !sleeping)
+		{
+			mSoAWrites.push_back({ nullptr, nullptr, 0, position, orientation, entry.node });
+			continue;
+		}
+
+		if (entry.local)
+		{
+			entry.node->setOrientation(orientation);
+			entry.node->setPosition(position);
+		}
+		else
+		{
+			entry.node->_setDerivedOrientation(orientation);
+			entry.node->_setDerivedPosition(position);
+		}
+
+		if (sleeping && !entry.isStatic)
+		{
+			entry.node->setStatic(true);
+			entry.isStatic = true;
+			++mStaticNodeCount;
+		}
+
+		//Static nodes are only updated by Ogre when flagged dirty
+		if (entry.isStatic)
+			entry.node->getCreator()->notifyStaticDirty(entry.node);
+	}
+
+	writeSoA();
+
+	BTOGRE_PROFILE_COUNT(NodesWritten, mMoved.size());
+	return mMoved.size();
+}
+
+void BodySyncSystem::writeSoA()
+{
+	for (auto& write : mSoAWrites)
+	{
+		const auto& transform = write.node->_getTransform();
+		write.position = transform.mPosition;
+		write.orientation = transform.mOrientation;
+		write.index = transform.mIndex;
+	}
+
+	//Nodes sharing a SoA block end up next to each other, and the memory is written in order
+	std::sort(mSoAWrites.begin(), mSoAWrites.end(), [](const SoAWrite& a, const SoAWrite& b)
+	{
+		return a.position != b.position ? std::less<ArrayVector3*>()(a.position, b.position) : a.index < b.index;
+	});
+
+	for (auto first = size_t{ 0U }; first < mSoAWrites.size();)
+	{
+		auto last = first + 1;
+		while (last < mSoAWrites.size() && mSoAWrites[last].position == mSoAWrites[first].position) ++last;
+
+		if (last - first == ARRAY_PACKED_REALS)
+		{
+			//Every lane of the block moved: pack them and store the whole block at once
+			ArrayVector3 positions;
+			ArrayQuaternion orientations;
+			for (auto i = first; i < last; ++i)
+			{
+				positions.setFromVector3(mSoAWrites[i].value, mSoAWrites[i].index);
+				orientations.setFromQuaternion(mSoAWrites[i].rotation, mSoAWrites[i].index);
+			}
+			*mSoAWrites[first].position = positions;
+			*mSoAWrites[first].orientation = orientations;
+		}
+		else
+		{
+			for (auto i = first; i < last; ++i)
+			{
+				mSoAWrites[i].position->setFromVector3(mSoAWrites[i].value, mSoAWrites[i].index);
+				mSoAWrites[i].orientation->setFromQuaternion(mSoAWrites[i].rotation, mSoAWrites[i].index);
+			}
+		}
+
+#if OGRE_DEBUG_MODE
+		//What setPosition() and setOrientation() would have done, so Ogre doesn't assert on the cached transforms
+		for (auto i = first; i < last; ++i)
+			mSoAWrites[i].node->_setCachedTransformOutOfDate();
+#endif
+
+		first = last;
+	}
+}
+
+size_t BodySyncSystem::getBodyCount() const
+{
+	return mEntries.size();
+}
+
+void BodySyncSystem::setStaticSleepingNodes(bool enable)
+{
+	mStaticSleepingNodes = enable;
+}
+
+size_t BodySyncSystem::getStaticNodeCount() const
+{
+	return mStaticNodeCount;
+}
+
+void BodySyncSystem::shiftOrigin(const btVector3& offset)
+{
+	for (auto& entry : mEntries)
+		entry.written.getOrigin() -= offset;
+}
+
+void DeferredRigidBodyState::setWorldTransform(const btTransform& in)
+{
+	if (!mNode) return;
+
+	//store transform
+	mTransform = in;
+
+	//extract position and orientation, the node will get them on the render thread
+	const auto transform = mTransform * mCenterOfMassOffset;
+	mQueue->push(this, mNode, Convert::toOgre(transform.getOrigin()), Convert::toOgre(transform.getRotation()));
+}
@@ -0,0 +1,153 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreProfiling.cpp
+ *
+ *    Description:  BtOgre profiling zones implementation.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreProfiling.h"
+
+#include <atomic>
+#include <mutex>
+
+using namespace BtOgre;
+
+namespace
+{
+	constexpr auto stageCount = size_t(ProfileStage::Count);
+	constexpr auto counterCount = size_t(ProfileCounter::Count);
+
+	///Frame being recorded. Static storage, so zero initialized
+	std::array<std::atomic<std::uint64_t>, stageCount> stageNanoseconds;
+	std::array<std::atomic<std::uint64_t>, stageCount> stageCalls;
+	std::array<std::atomic<std::uint64_t>, counterCount> counterValues;
+
+	Profiler::Callback callback;
+
+	///Closed frames
+	std::mutex ringMutex;
+	std::vector<ProfileFrame> ring;
+	size_t ringSize{ 0 };
+	size_t ringStart{ 0 };
+	ProfileFrame lastFrame{};
+
+	///Read the frame being recorded, and reset it if asked to
+	ProfileFrame snapshot(bool reset)
+	{
+		ProfileFrame frame;
+		for (auto i = size_t{ 0U }; i < stageCount; ++i)
+		{
+			const auto nanoseconds = reset ? stageNanoseconds[i].exchange(0) : stageNanoseconds[i].load();
+			frame.milliseconds[i] = double(nanoseconds) / 1e6;
+			frame.calls[i] = reset ? stageCalls[i].exchange(0) : stageCalls[i].load();
+		}
+		for (auto i = size_t{ 0U }; i < counterCount; ++i)
+			frame.counters[i] = reset ? counterValues[i].exchange(0) : counterValues[i].load();
+		return frame;
+	}
+}
+
+void Profiler::setCallback(Callback function)
+{
+	callback = std::move(function);
+}
+
+void Profiler::setFrameRingSize(size_t frames)
+{
+	std::lock_guard<std::mutex> lock(ringMutex);
+	ring.clear();
+	ring.reserve(frames);
+	ringSize = frames;
+	ringStart = 0;
+}
+
+void Profiler::endFrame()
+{
+	const auto frame = snapshot(true);
+
+	std::lock_guard<std::mutex> lock(ringMutex);
+	lastFrame = frame;
+	if (!ringSize) return;
+
+	//Once full, the oldest frame is overwritten
+	if (ring.size() < ringSize)
+	{
+		ring.push_back(frame);
+	}
+	else
+	{
+		ring[ringStart] = frame;
+		ringStart = (ringStart + 1) % ringSize;
+	}
+}
+
+ProfileFrame Profiler::getCurrentFrame()
+{
+	return snapshot(false);
+}
+
+ProfileFrame Profiler::getLastFrame()
+{
+	std::lock_guard<std::mutex> lock(ringMutex);
+	return lastFrame;
+}
+
+std::vector<ProfileFrame> Profiler::getFrames()
+{
+	std::lock_guard<std::mutex> lock(ringMutex);
+	std::vector<ProfileFrame> frames;
+	frames.reserve(ring.size());
+	for (auto i = size_t{ 0U }; i < ring.size(); ++i)
+		frames.push_back(ring[(ringStart + i) % ring.size()]);
+	return frames;
+}
+
+const char* Profiler::getStageName(ProfileStage stage)
+{
+	switch (stage)
+	{
+	case ProfileStage::V1VertexData: return "V1VertexData";
+	case ProfileStage::V2VertexData: return "V2VertexData";
+	case ProfileStage::BufferMapping: return "BufferMapping";
+	case ProfileStage::VertexTransform: return "VertexTransform";
+	case ProfileStage::Trimesh: return "Trimesh";
+	case ProfileStage::BvhBuild: return "BvhBuild";
+	case ProfileStage::MotionStateSync: return "MotionStateSync";
+	case ProfileStage::DebugLineUpload: return "DebugLineUpload";
+	case ProfileStage::Simulation: return "Simulation";
+	default: return "Unknown";
+	}
+}
+
+const char* Profiler::getCounterName(ProfileCounter counter)
+{
+	switch (counter)
+	{
+	case ProfileCounter::VerticesProcessed: return "VerticesProcessed";
+	case ProfileCounter::LinesDrawn: return "LinesDrawn";
+	case ProfileCounter::NodesWritten: return "NodesWritten";
+	default: return "Unknown";
+	}
+}
+
+void Profiler::record(ProfileStage stage, std::chrono::steady_clock::duration duration)
+{
+	const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+	stageNanoseconds[size_t(stage)].fetch_add(std::uint64_t(nanoseconds), std::memory_order_relaxed);
+	stageCalls[size_t(stage)].fetch_add(1, std::memory_order_relaxed);
+
+	if (callback) callback(stage, double(nanoseconds) / 1e6);
+}
+
+void Profiler::count(ProfileCounter counter, std::uint64_t amount)
+{
+	counterValues[size_t(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
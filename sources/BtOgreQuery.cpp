@@ -0,0 +1,272 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreQuery.cpp
+ *
+ *    Description:  BtOgre query batch implementation.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreQuery.h"
+
+#include <BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
+#include <LinearMath/btTransformUtil.h>
+
+#include <algorithm>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	///Bullet result callback skipping one object
+	template <typename Base> struct IgnoringCallback : public Base
+	{
+		IgnoringCallback(const btVector3& from, const btVector3& to, const btCollisionObject* ignoredObject, int group, int mask) :
+			Base(from, to),
+			ignored(ignoredObject)
+		{
+			this->m_collisionFilterGroup = group;
+			this->m_collisionFilterMask = mask;
+		}
+
+		bool needsCollision(btBroadphaseProxy* proxy) const override
+		{
+			return proxy->m_clientObject != ignored && Base::needsCollision(proxy);
+		}
+
+		const btCollisionObject* ignored;
+	};
+
+	using RayCallback = IgnoringCallback<btCollisionWorld::ClosestRayResultCallback>;
+	using SweepCallback = IgnoringCallback<btCollisionWorld::ClosestConvexResultCallback>;
+
+	///Test the ray against each object whose leaf the broadphase traversal reaches
+	struct RayLeafPolicy : public btDbvt::ICollide
+	{
+		RayLeafPolicy(const btTransform& rayFrom, const btTransform& rayTo, RayCallback& rayCallback) :
+			from(rayFrom),
+			to(rayTo),
+			callback(rayCallback)
+		{
+		}
+
+		void Process(const btDbvtNode* leaf) override
+		{
+			const auto proxy = static_cast<btBroadphaseProxy*>(leaf->data);
+			if (callback.m_closestHitFraction == 0 || !callback.needsCollision(proxy)) return;
+
+			const auto object = static_cast<const btCollisionObject*>(proxy->m_clientObject);
+			btCollisionWorld::rayTestSingle(from, to, const_cast<btCollisionObject*>(object), object->getCollisionShape(), object->getWorldTransform(), callback);
+		}
+
+		const btTransform& from;
+		const btTransform& to;
+		RayCallback& callback;
+	};
+
+	///Sweep the shape against each object whose leaf the broadphase traversal reaches
+	struct SweepLeafPolicy : public btDbvt::ICollide
+	{
+		SweepLeafPolicy(const btConvexShape* sweptShape, const btTransform& sweepFrom, const btTransform& sweepTo, btScalar penetration, SweepCallback& sweepCallback) :
+			shape(sweptShape),
+			from(sweepFrom),
+			to(sweepTo),
+			allowedPenetration(penetration),
+			callback(sweepCallback)
+		{
+		}
+
+		void Process(const btDbvtNode* leaf) override
+		{
+			const auto proxy = static_cast<btBroadphaseProxy*>(leaf->data);
+			if (callback.m_closestHitFraction == 0 || !callback.needsCollision(proxy)) return;
+
+			const auto object = static_cast<const btCollisionObject*>(proxy->m_clientObject);
+			btCollisionWorld::objectQuerySingle(shape, from, to, const_cast<btCollisionObject*>(object), object->getCollisionShape(), object->getWorldTransform(), callback, allowedPenetration);
+		}
+
+		const btConvexShape* shape;
+		const btTransform& from;
+		const btTransform& to;
+		btScalar allowedPenetration;
+		SweepCallback& callback;
+	};
+}
+
+QueryBatch::QueryBatch(btCollisionWorld* world, TaskPool* pool, const BodyRegistry* registry) :
+	mWorld(world),
+	mPool(pool),
+	mRegistry(registry)
+{
+}
+
+void QueryBatch::clear()
+{
+	mQueries.clear();
+	mResults.clear();
+}
+
+size_t QueryBatch::addRay(const Ray& ray, Real distance, const btCollisionObject* ignored, int group, int mask)
+{
+	return addSegment(ray.getOrigin(), ray.getPoint(distance), ignored, group, mask);
+}
+
+size_t QueryBatch::addSegment(const Vector3& from, const Vector3& to, const btCollisionObject* ignored, int group, int mask)
+{
+	mQueries.push_back({ nullptr, Convert::toBullet(from), Convert::toBullet(to), btQuaternion::getIdentity(), ignored, group, mask });
+	return mQueries.size() - 1;
+}
+
+size_t QueryBatch::addSweep(const btConvexShape* shape, const Vector3& from, const Vector3& to, const Quaternion& orientation, const btCollisionObject* ignored, int group, int mask)
+{
+	mQueries.push_back({ shape, Convert::toBullet(from), Convert::toBullet(to), Convert::toBullet(orientation), ignored, group, mask });
+	return mQueries.size() - 1;
+}
+
+size_t QueryBatch::getQueryCount() const
+{
+	return mQueries.size();
+}
+
+const std::vector<QueryHit>& QueryBatch::getResults() const
+{
+	return mResults;
+}
+
+void QueryBatch::execute()
+{
+	mResults.resize(mQueries.size());
+
+	//Without a thread safe way through the broadphase, everything goes through the world on this thread
+	if (!dynamic_cast<btDbvtBroadphase*>(mWorld->getBroadphase()))
+	{
+		for (auto i = size_t{ 0U }; i < mQueries.size(); ++i)
+			runQueryOnWorld(mQueries[i], mResults[i]);
+		return;
+	}
+
+	//A few chunks per thread, so the threads done early can steal the rest
+	const auto chunks = mPool ? std::min(mQueries.size(), mPool->getThreadCount() * 4) : size_t{ 1U };
+	if (mStacks.size() < chunks) mStacks.resize(chunks);
+	if (!chunks) return;
+
+	if (!mPool)
+	{
+		run(0, mQueries.size(), mStacks[0]);
+		return;
+	}
+
+	const auto chunkSize = (mQueries.size() + chunks - 1) / chunks;
+	mPool->run(chunks, [this, chunkSize](size_t chunk)
+	{
+		const auto begin = chunk * chunkSize;
+		const auto end = std::min(begin + chunkSize, mQueries.size());
+		if (begin < end) run(begin, end, mStacks[chunk]);
+	});
+}
+
+void QueryBatch::run(size_t begin, size_t end, btAlignedObjectArray<const btDbvtNode*>& stack)
+{
+	for (auto i = begin; i < end; ++i)
+		runQuery(mQueries[i], mResults[i], stack);
+}
+
+void QueryBatch::runQuery(const Query& query, QueryHit& hit, btAlignedObjectArray<const btDbvtNode*>& stack) const
+{
+	hit = { false, Vector3::ZERO, Vector3::ZERO, 1, nullptr, {}, nullptr };
+
+	//Same ray setup as btCollisionWorld, the traversal stops at lambdaMax along the normalized direction
+	auto direction = query.to - query.from;
+	if (direction.length2() < SIMD_EPSILON) return;
+	direction.normalize();
+
+	btVector3 directionInverse;
+	unsigned int signs[3];
+	for (auto axis = 0; axis < 3; ++axis)
+	{
+		directionInverse[axis] = direction[axis] == btScalar(0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1) / direction[axis];
+		signs[axis] = directionInverse[axis] < 0;
+	}
+	const auto lambdaMax = direction.dot(query.to - query.from);
+	const auto broadphase = static_cast<btDbvtBroadphase*>(mWorld->getBroadphase());
+
+	const auto traverse = [&](btDbvt::ICollide& policy, const btVector3& aabbMin, const btVector3& aabbMax)
+	{
+		//Both trees: the moving proxies and the static ones
+		for (auto& set : broadphase->m_sets)
+			set.rayTestInternal(set.m_root, query.from, query.to, directionInverse, signs, lambdaMax, aabbMin, aabbMax, stack, policy);
+	};
+
+	if (!query.shape)
+	{
+		RayCallback callback(query.from, query.to, query.ignored, query.group, query.mask);
+		const btTransform from(btQuaternion::getIdentity(), query.from);
+		const btTransform to(btQuaternion::getIdentity(), query.to);
+
+		RayLeafPolicy policy(from, to, callback);
+		traverse(policy, btVector3(0, 0, 0), btVector3(0, 0, 0));
+
+		if (!callback.hasHit()) return;
+		hit = { true, Convert::toOgre(callback.m_hitPointWorld), Convert::toOgre(callback.m_hitNormalWorld), Real(callback.m_closestHitFraction), callback.m_collisionObject, {}, nullptr };
+	}
+	else
+	{
+		SweepCallback callback(query.from, query.to, query.ignored, query.group, query.mask);
+		const btTransform from(query.orientation, query.from);
+		const btTransform to(query.orientation, query.to);
+
+		//Bounds of the shape around the ray, grown by its rotation, as btCollisionWorld::convexSweepTest() does
+		btVector3 linearVelocity, angularVelocity, aabbMin, aabbMax;
+		btTransformUtil::calculateVelocity(from, to, 1, linearVelocity, angularVelocity);
+		btTransform rotation(from.getRotation());
+		query.shape->calculateTemporalAabb(rotation, btVector3(0, 0, 0), angularVelocity, 1, aabbMin, aabbMax);
+
+		SweepLeafPolicy policy(query.shape, from, to, mWorld->getDispatchInfo().m_allowedCcdPenetration, callback);
+		traverse(policy, aabbMin, aabbMax);
+
+		if (!callback.hasHit()) return;
+		hit = { true, Convert::toOgre(callback.m_hitPointWorld), Convert::toOgre(callback.m_hitNormalWorld), Real(callback.m_closestHitFraction), callback.m_hitCollisionObject, {}, nullptr };
+	}
+
+	mapHit(hit);
+}
+
+void QueryBatch::runQueryOnWorld(const Query& query, QueryHit& hit) const
+{
+	hit = { false, Vector3::ZERO, Vector3::ZERO, 1, nullptr, {}, nullptr };
+	if ((query.to - query.from).length2() < SIMD_EPSILON) return;
+
+	if (!query.shape)
+	{
+		RayCallback callback(query.from, query.to, query.ignored, query.group, query.mask);
+		mWorld->rayTest(query.from, query.to, callback);
+
+		if (!callback.hasHit()) return;
+		hit = { true, Convert::toOgre(callback.m_hitPointWorld), Convert::toOgre(callback.m_hitNormalWorld), Real(callback.m_closestHitFraction), callback.m_collisionObject, {}, nullptr };
+	}
+	else
+	{
+		SweepCallback callback(query.from, query.to, query.ignored, query.group, query.mask);
+		mWorld->convexSweepTest(query.shape, btTransform(query.orientation, query.from), btTransform(query.orientation, query.to), callback);
+
+		if (!callback.hasHit()) return;
+		hit = { true, Convert::toOgre(callback.m_hitPointWorld), Convert::toOgre(callback.m_hitNormalWorld), Real(callback.m_closestHitFraction), callback.m_hitCollisionObject, {}, nullptr };
+	}
+
+	mapHit(hit);
+}
+
+void QueryBatch::mapHit(QueryHit& hit) const
+{
+	if (!mRegistry || !hit.object) return;
+
+	hit.body = mRegistry->getHandle(hit.object);
+	hit.item = mRegistry->getItem(hit.body);
+}
@@ -0,0 +1,242 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreRegistry.cpp
+ *
+ *    Description:  BtOgre body registry implementation.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreRegistry.h"
+
+#include <OgreSceneManager.h>
+#include <stdexcept>
+#include <typeinfo>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+BodyRegistry::BodyRegistry(btDynamicsWorld* world) :
+	mWorld(world),
+	mFreeSlot(BodyHandle::INVALID_INDEX)
+{
+}
+
+BodyRegistry::~BodyRegistry()
+{
+	while (!mBodies.empty())
+	{
+		const auto slot = mDenseToSlot.back();
+		destroy({ slot, mSlots[slot].generation });
+	}
+}
+
+BodyHandle BodyRegistry::create(btScalar mass, btCollisionShape* shape, SceneNode* node, Item* item, bool ownsShape)
+{
+	btVector3 inertia(0, 0, 0);
+	if (mass != 0) shape->calculateLocalInertia(mass, inertia);
+
+	const auto state = node ? static_cast<btMotionState*>(new RigidBodyState(node)) : new btDefaultMotionState;
+	return add(new btRigidBody(mass, state, shape, inertia), node, item, ownsShape);
+}
+
+BodyHandle BodyRegistry::add(btRigidBody* body, SceneNode* node, Item* item, bool ownsShape)
+{
+	if (getHandle(body)) throw std::runtime_error("BodyRegistry::add : body already registered");
+
+	//Reuse a free slot first, so the slot array doesn't grow with the churn
+	auto slot = mFreeSlot;
+	if (slot != BodyHandle::INVALID_INDEX)
+	{
+		mFreeSlot = mSlots[slot].dense;
+	}
+	else
+	{
+		slot = uint32(mSlots.size());
+		mSlots.push_back({ 0, 0 });
+	}
+
+	const BodyHandle handle{ slot, mSlots[slot].generation };
+	mSlots[slot].dense = uint32(mBodies.size());
+
+	mBodies.push_back(body);
+	mStates.push_back(dynamic_cast<RigidBodyState*>(body->getMotionState()));
+	mNodes.push_back(node);
+	mItems.push_back(item);
+	mOwnsShape.push_back(ownsShape);
+	mDenseToSlot.push_back(slot);
+
+	body->setUserIndex(int(slot));
+	if (node) node->getUserObjectBindings().setUserAny(Any(handle));
+	if (item) item->getUserObjectBindings().setUserAny(Any(handle));
+
+	if (!body->isInWorld()) mWorld->addRigidBody(body);
+	return handle;
+}
+
+void BodyRegistry::destroy(BodyHandle handle, bool destroySceneObjects)
+{
+	const auto dense = getDenseIndex(handle);
+	if (dense == BodyHandle::INVALID_INDEX) return;
+
+	auto body = mBodies[dense];
+	auto node = mNodes[dense];
+	auto item = mItems[dense];
+
+	mWorld->removeRigidBody(body);
+	delete body->getMotionState();
+	if (mOwnsShape[dense]) deleteShape(body->getCollisionShape());
+	delete body;
+
+	if (item)
+	{
+		item->getUserObjectBindings().setUserAny(Any());
+		if (destroySceneObjects) item->_getManager()->destroyItem(item);
+	}
+	if (node)
+	{
+		node->getUserObjectBindings().setUserAny(Any());
+		if (destroySceneObjects) node->getCreator()->destroySceneNode(node);
+	}
+
+	//Move the last body in the hole to keep the arrays dense
+	const auto last = uint32(mBodies.size() - 1);
+	if (dense != last)
+	{
+		mBodies[dense] = mBodies[last];
+		mStates[dense] = mStates[last];
+		mNodes[dense] = mNodes[last];
+		mItems[dense] = mItems[last];
+		mOwnsShape[dense] = mOwnsShape[last];
+		mDenseToSlot[dense] = mDenseToSlot[last];
+		mSlots[mDenseToSlot[dense]].dense = dense;
+	}
+	mBodies.pop_back();
+	mStates.pop_back();
+	mNodes.pop_back();
+	mItems.pop_back();
+	mOwnsShape.pop_back();
+	mDenseToSlot.pop_back();
+
+	//The generation change invalidates the handles still pointing to the slot
+	auto& slot = mSlots[handle.index];
+	++slot.generation;
+	slot.dense = mFreeSlot;
+	mFreeSlot = handle.index;
+}
+
+uint32 BodyRegistry::getDenseIndex(BodyHandle handle) const
+{
+	if (handle.index >= mSlots.size()) return BodyHandle::INVALID_INDEX;
+
+	const auto& slot = mSlots[handle.index];
+	if (slot.generation != handle.generation) return BodyHandle::INVALID_INDEX;
+
+	//A free slot with the same generation can't happen: freeing a slot bumps its generation
+	return slot.dense;
+}
+
+bool BodyRegistry::isValid(BodyHandle handle) const
+{
+	return getDenseIndex(handle) != BodyHandle::INVALID_INDEX;
+}
+
+btRigidBody* BodyRegistry::getBody(BodyHandle handle) const
+{
+	const auto dense = getDenseIndex(handle);
+	return dense != BodyHandle::INVALID_INDEX ? mBodies[dense] : nullptr;
+}
+
+RigidBodyState* BodyRegistry::getMotionState(BodyHandle handle) const
+{
+	const auto dense = getDenseIndex(handle);
+	return dense != BodyHandle::INVALID_INDEX ? mStates[dense] : nullptr;
+}
+
+SceneNode* BodyRegistry::getNode(BodyHandle handle) const
+{
+	const auto dense = getDenseIndex(handle);
+	return dense != BodyHandle::INVALID_INDEX ? mNodes[dense] : nullptr;
+}
+
+Item* BodyRegistry::getItem(BodyHandle handle) const
+{
+	const auto dense = getDenseIndex(handle);
+	return dense != BodyHandle::INVALID_INDEX ? mItems[dense] : nullptr;
+}
+
+BodyHandle BodyRegistry::getHandle(const btCollisionObject* object) const
+{
+	//The user index may have been set by someone else: only trust it if the slot holds this very object
+	const auto index = object->getUserIndex();
+	if (index < 0 || size_t(index) >= mSlots.size()) return {};
+
+	const auto& slot = mSlots[index];
+	if (slot.dense >= mBodies.size() || mDenseToSlot[slot.dense] != uint32(index) || mBodies[slot.dense] != object) return {};
+
+	return { uint32(index), slot.generation };
+}
+
+BodyHandle BodyRegistry::getHandle(const Node* node) const
+{
+	return readHandle(node->getUserObjectBindings());
+}
+
+BodyHandle BodyRegistry::getHandle(const MovableObject* item) const
+{
+	return readHandle(item->getUserObjectBindings());
+}
+
+BodyHandle BodyRegistry::readHandle(const UserObjectBindings& bindings) const
+{
+	const auto& any = bindings.getUserAny();
+	if (any.isEmpty() || any.getType() != typeid(BodyHandle)) return {};
+
+	const auto handle = any_cast<BodyHandle>(any);
+	return isValid(handle) ? handle : BodyHandle();
+}
+
+size_t BodyRegistry::getBodyCount() const
+{
+	return mBodies.size();
+}
+
+const std::vector<btRigidBody*>& BodyRegistry::getBodies() const
+{
+	return mBodies;
+}
+
+const std::vector<SceneNode*>& BodyRegistry::getNodes() const
+{
+	return mNodes;
+}
+
+const std::vector<Item*>& BodyRegistry::getItems() const
+{
+	return mItems;
+}
+
+void BodyRegistry::deleteShape(btCollisionShape* shape)
+{
+	if (!shape) return;
+
+	if (shape->isCompound())
+	{
+		auto compound = static_cast<btCompoundShape*>(shape);
+		for (auto i = 0; i < compound->getNumChildShapes(); ++i)
+			deleteShape(compound->getChildShape(i));
+	}
+	else if (shape->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE)
+	{
+		//The quirk of the triangle based shapes: they don't own their mesh interface
+		delete static_cast<btTriangleMeshShape*>(shape)->getMeshInterface();
+	}
+
+	delete shape;
+}
@@ -0,0 +1,418 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreShapeCache.cpp
+ *
+ *    Description:  BtOgre on-disk shape cache implementation.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreShapeCache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <BulletCollision/CollisionShapes/btOptimizedBvh.h>
+#include <LinearMath/btConvexHullComputer.h>
+#include <OgreLogManager.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	inline void log(const std::string& message)
+	{
+		LogManager::getSingleton().logMessage("BtOgreLog : " + message);
+	}
+
+	///Version of the entry layout, bump it when it changes
+	constexpr uint32 entryVersion{ 1 };
+
+	///First bytes of every entry
+	constexpr char entryMagic[8]{ 'B', 'T', 'O', 'G', 'R', 'E', 'S', 'C' };
+
+	///Header at the start of every entry. Entries are written in the native byte order and layout, they aren't meant to be shared between machines
+	struct EntryHeader
+	{
+		char magic[8];
+		uint32 version;
+		uint32 kind;
+		uint64 key;
+
+		///The serialized BVH layout depend on the Bullet version, precision and pointer size
+		uint32 bulletVersion;
+		uint32 scalarSize;
+		uint32 realSize;
+		uint32 pointerSize;
+
+		uint32 vertexCount;
+		uint32 indexCount;
+		uint64 vertexOffset;
+		uint64 indexOffset;
+		uint64 bvhOffset;
+		uint64 bvhSize;
+	};
+
+	///In place BVH deserialization needs 16 bytes aligned data
+	constexpr size_t entryAlignment{ 16 };
+
+	size_t alignEntryOffset(size_t offset)
+	{
+		return (offset + entryAlignment - 1) & ~(entryAlignment - 1);
+	}
+
+	///FNV-1a 64 bits hash
+	class KeyHash
+	{
+	public:
+		void add(const void* data, size_t size)
+		{
+			const auto bytes = static_cast<const unsigned char*>(data);
+			for (auto i = size_t{ 0U }; i < size; ++i)
+				mHash = (mHash ^ bytes[i]) * 0x100000001b3ULL;
+		}
+
+		template <typename T> void addValue(const T& value) { add(&value, sizeof(T)); }
+
+		uint64 get() const { return mHash; }
+
+	private:
+		uint64 mHash{ 0xcbf29ce484222325ULL };
+	};
+
+	///Check that an entry is complete and was written for this build
+	bool isValidEntry(const EntryHeader& header, size_t size, uint64 key, ShapeCache::ShapeKind kind)
+	{
+		return std::memcmp(header.magic, entryMagic, sizeof entryMagic) == 0
+			&& header.version == entryVersion
+			&& header.kind == kind
+			&& header.key == key
+			&& header.bulletVersion == BT_BULLET_VERSION
+			&& header.scalarSize == sizeof(btScalar)
+			&& header.realSize == sizeof(Real)
+			&& header.pointerSize == sizeof(void*)
+			&& header.vertexOffset + header.vertexCount * sizeof(Vector3) <= size
+			&& header.indexOffset + header.indexCount * sizeof(unsigned int) <= size
+			&& header.bvhOffset + header.bvhSize <= size;
+	}
+
+	///Create a header for an entry
+	EntryHeader makeEntryHeader(uint64 key, ShapeCache::ShapeKind kind)
+	{
+		EntryHeader header{};
+		std::memcpy(header.magic, entryMagic, sizeof entryMagic);
+		header.version = entryVersion;
+		header.kind = kind;
+		header.key = key;
+		header.bulletVersion = BT_BULLET_VERSION;
+		header.scalarSize = sizeof(btScalar);
+		header.realSize = sizeof(Real);
+		header.pointerSize = sizeof(void*);
+		return header;
+	}
+
+	///Map a whole file copy-on-write: in place BVH deserialization writes in the BVH header, this never reaches the file.
+	///Return false if the file doesn't exist or is too small to be an entry
+	bool mapEntry(const String& path, void*& data, size_t& size)
+	{
+#ifdef _WIN32
+		const auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		const auto mapping = GetFileSizeEx(file, &fileSize) && size_t(fileSize.QuadPart) >= sizeof(EntryHeader)
+			? CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr)
+			: nullptr;
+		CloseHandle(file);
+		if (!mapping) return false;
+
+		data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(mapping);
+		size = size_t(fileSize.QuadPart);
+		return data != nullptr;
+#else
+		const auto file = open(path.c_str(), O_RDONLY);
+		if (file < 0) return false;
+
+		struct stat status;
+		if (fstat(file, &status) != 0 || size_t(status.st_size) < sizeof(EntryHeader))
+		{
+			close(file);
+			return false;
+		}
+
+		size = size_t(status.st_size);
+		data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		close(file);
+		return data != MAP_FAILED;
+#endif
+	}
+
+	///Release a mapping made by mapEntry()
+	void unmapEntry(void* data, size_t size)
+	{
+#ifdef _WIN32
+		(void)size;
+		UnmapViewOfFile(data);
+#else
+		munmap(data, size);
+#endif
+	}
+
+	///Move a file over another one, replacing it
+	bool replaceFile(const String& source, const String& destination)
+	{
+#ifdef _WIN32
+		return MoveFileExA(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return std::rename(source.c_str(), destination.c_str()) == 0;
+#endif
+	}
+
+	unsigned long processId()
+	{
+#ifdef _WIN32
+		return GetCurrentProcessId();
+#else
+		return static_cast<unsigned long>(getpid());
+#endif
+	}
+}
+
+/*
+ * =============================================================================================
+ * BtOgre::CachedTriangleMesh
+ * =============================================================================================
+ */
+
+CachedTriangleMesh::CachedTriangleMesh(void* data, size_t size, const btIndexedMesh& mesh) :
+	mData(data),
+	mSize(size)
+{
+	addIndexedMesh(mesh, mesh.m_indexType);
+}
+
+CachedTriangleMesh::~CachedTriangleMesh()
+{
+	unmapEntry(mData, mSize);
+}
+
+/*
+ * =============================================================================================
+ * BtOgre::ShapeCache
+ * =============================================================================================
+ */
+
+ShapeCache* ShapeCache::sDefault{ nullptr };
+
+ShapeCache::ShapeCache(const String& directory) :
+	mDirectory(directory)
+{
+	//Fails harmlessly if the directory already exists
+#ifdef _WIN32
+	CreateDirectoryA(mDirectory.c_str(), nullptr);
+#else
+	mkdir(mDirectory.c_str(), 0755);
+#endif
+}
+
+const String& ShapeCache::getDirectory() const
+{
+	return mDirectory;
+}
+
+uint64 ShapeCache::computeKey(ShapeKind kind, const Vector3* vertices, size_t vertexCount,
+	const unsigned int* indices, size_t indexCount, const Vector3& scale)
+{
+	KeyHash hash;
+	hash.addValue(entryVersion);
+	hash.addValue(kind);
+	hash.addValue(uint64(vertexCount));
+	hash.addValue(uint64(indexCount));
+	hash.add(vertices, vertexCount * sizeof(Vector3));
+	hash.add(indices, indexCount * sizeof(unsigned int));
+	hash.add(scale.ptr(), 3 * sizeof(Real));
+	return hash.get();
+}
+
+String ShapeCache::getEntryPath(uint64 key, ShapeKind kind) const
+{
+	char name[32];
+	std::snprintf(name, sizeof name, "%016llx", static_cast<unsigned long long>(key));
+	return mDirectory + "/" + name + (kind == TRIMESH ? ".trimesh" : ".convex");
+}
+
+void ShapeCache::writeEntry(const String& path, const void* data, size_t size) const
+{
+	static std::atomic<unsigned> temporaryCount{ 0 };
+	const auto temporary = path + "." + std::to_string(processId()) + "." + std::to_string(temporaryCount++) + ".tmp";
+
+	auto written = false;
+	{
+		std::ofstream file(temporary, std::ios::binary);
+		file.write(static_cast<const char*>(data), size);
+		written = bool(file);
+	}
+
+	if (!written || !replaceFile(temporary, path))
+	{
+		std::remove(temporary.c_str());
+		log("cannot write shape cache entry " + path);
+	}
+}
+
+btBvhTriangleMeshShape* ShapeCache::loadTrimesh(uint64 key, size_t vertexCount, size_t indexCount, const btVector3& scale) const
+{
+	void* data;
+	size_t size;
+	if (!mapEntry(getEntryPath(key, TRIMESH), data, size)) return nullptr;
+
+	const auto bytes = static_cast<unsigned char*>(data);
+	const auto& header = *static_cast<const EntryHeader*>(data);
+	if (!isValidEntry(header, size, key, TRIMESH) || header.vertexCount != vertexCount || header.indexCount != indexCount || !header.bvhSize)
+	{
+		unmapEntry(data, size);
+		return nullptr;
+	}
+
+	//The vertices and indices are used where they are in the mapping
+	btIndexedMesh mesh;
+	mesh.m_numTriangles = int(indexCount / 3);
+	mesh.m_triangleIndexBase = bytes + header.indexOffset;
+	mesh.m_triangleIndexStride = 3 * sizeof(unsigned int);
+	mesh.m_indexType = PHY_INTEGER;
+	mesh.m_numVertices = int(vertexCount);
+	mesh.m_vertexBase = bytes + header.vertexOffset;
+	mesh.m_vertexStride = sizeof(Vector3);
+	mesh.m_vertexType = sizeof(Real) == sizeof(double) ? PHY_DOUBLE : PHY_FLOAT;
+
+	//The BVH nodes too. The BVH isn't owned by the shape, it goes away with the mapping when the mesh interface is deleted
+	const auto meshInterface = new CachedTriangleMesh(data, size, mesh);
+	const auto bvh = btOptimizedBvh::deSerializeInPlace(bytes + header.bvhOffset, unsigned(header.bvhSize), false);
+	if (!bvh)
+	{
+		delete meshInterface;
+		return nullptr;
+	}
+
+	const auto useQuantizedAABB = true;
+	const auto buildBvh = false;
+	auto shape = new btBvhTriangleMeshShape(meshInterface, useQuantizedAABB, buildBvh);
+
+	//The BVH was stored already built for this scale, setting it with the BVH avoids a rebuild
+	shape->setOptimizedBvh(bvh, scale);
+
+	return shape;
+}
+
+void ShapeCache::storeTrimesh(uint64 key, const Vector3* vertices, size_t vertexCount,
+	const unsigned int* indices, size_t indexCount, btBvhTriangleMeshShape* shape) const
+{
+	const auto bvh = shape->getOptimizedBvh();
+	if (!bvh) return;
+
+	auto header = makeEntryHeader(key, TRIMESH);
+	header.vertexCount = uint32(vertexCount);
+	header.indexCount = uint32(indexCount);
+	header.vertexOffset = alignEntryOffset(sizeof(EntryHeader));
+	header.indexOffset = alignEntryOffset(header.vertexOffset + vertexCount * sizeof(Vector3));
+	header.bvhOffset = alignEntryOffset(header.indexOffset + indexCount * sizeof(unsigned int));
+	header.bvhSize = bvh->calculateSerializeBufferSize();
+
+	const auto size = size_t(header.bvhOffset + header.bvhSize);
+	const auto entry = static_cast<unsigned char*>(btAlignedAlloc(size, entryAlignment));
+	std::memset(entry, 0, size);
+	std::memcpy(entry, &header, sizeof header);
+	std::memcpy(entry + header.vertexOffset, vertices, vertexCount * sizeof(Vector3));
+	std::memcpy(entry + header.indexOffset, indices, indexCount * sizeof(unsigned int));
+
+	if (bvh->serializeInPlace(entry + header.bvhOffset, unsigned(header.bvhSize), false))
+		writeEntry(getEntryPath(key, TRIMESH), entry, size);
+
+	btAlignedFree(entry);
+}
+
+btConvexHullShape* ShapeCache::loadConvex(uint64 key) const
+{
+	void* data;
+	size_t size;
+	if (!mapEntry(getEntryPath(key, CONVEX), data, size)) return nullptr;
+
+	//btConvexHullShape keeps its own copy of the points, the mapping can go right away
+	const auto& header = *static_cast<const EntryHeader*>(data);
+	btConvexHullShape* shape{ nullptr };
+	if (isValidEntry(header, size, key, CONVEX) && header.vertexCount)
+	{
+		const auto points = reinterpret_cast<const Vector3*>(static_cast<const unsigned char*>(data) + header.vertexOffset);
+		shape = new btConvexHullShape{ &points[0].x, int(header.vertexCount), sizeof(Vector3) };
+	}
+
+	unmapEntry(data, size);
+	return shape;
+}
+
+btConvexHullShape* ShapeCache::storeConvex(uint64 key, const Vector3* points, size_t pointCount) const
+{
+	//Points inside the hull never contribute to the support function, only keep the vertices of the hull
+	btConvexHullComputer hull;
+	hull.compute(&points[0].x, sizeof(Vector3), int(pointCount), 0, 0);
+
+	std::vector<Vector3> hullPoints;
+	hullPoints.reserve(hull.vertices.size());
+	for (auto i = 0; i < hull.vertices.size(); ++i)
+		hullPoints.emplace_back(Real(hull.vertices[i].x()), Real(hull.vertices[i].y()), Real(hull.vertices[i].z()));
+
+	//A degenerate cloud can yield no hull, keep everything then
+	if (hullPoints.empty())
+		hullPoints.assign(points, points + pointCount);
+
+	auto header = makeEntryHeader(key, CONVEX);
+	header.vertexCount = uint32(hullPoints.size());
+	header.vertexOffset = alignEntryOffset(sizeof(EntryHeader));
+	header.indexOffset = header.vertexOffset + hullPoints.size() * sizeof(Vector3);
+	header.bvhOffset = header.indexOffset;
+
+	std::vector<unsigned char> entry(size_t(header.bvhOffset));
+	std::memcpy(entry.data(), &header, sizeof header);
+	std::memcpy(entry.data() + header.vertexOffset, hullPoints.data(), hullPoints.size() * sizeof(Vector3));
+
+	writeEntry(getEntryPath(key, CONVEX), entry.data(), entry.size());
+
+	//Built from the stored points, a miss gives the same shape as the hits that will follow
+	return new btConvexHullShape{ &hullPoints[0].x, int(hullPoints.size()), sizeof(Vector3) };
+}
+
+void ShapeCache::setDefault(ShapeCache* cache)
+{
+	sDefault = cache;
+}
+
+ShapeCache* ShapeCache::getDefault()
+{
+	return sDefault;
+}
@@ -0,0 +1,469 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreThreading.cpp
+ *
+ *    Description:  BtOgre threading implementation.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreThreading.h"
+#include "BtOgreExtras.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+PhysicsThread::PhysicsThread(btDiscreteDynamicsWorld* world, btScalar fixedTimeStep) :
+	mWorld(world),
+	mFixedTimeStep(fixedTimeStep),
+	mRunning(false),
+	mStepCount(0),
+	mLastStepTime(0),
+	mSnapshotStep(0)
+{
+}
+
+PhysicsThread::~PhysicsThread()
+{
+	stop();
+}
+
+void PhysicsThread::start()
+{
+	if (mRunning) return;
+	mRunning = true;
+	mThread = std::thread(&PhysicsThread::run, this);
+}
+
+void PhysicsThread::stop()
+{
+	if (!mThread.joinable()) return;
+	mRunning = false;
+	mThread.join();
+
+	//The commands queued after the last step, now on the calling thread
+	runCommands();
+	for (auto& callback : mPendingCallbacks)
+		mRemovedCallbacks.push(std::move(callback));
+	mPendingCallbacks.clear();
+}
+
+bool PhysicsThread::isRunning() const
+{
+	return mRunning;
+}
+
+void PhysicsThread::post(Command command)
+{
+	mCommands.push(std::move(command));
+}
+
+void PhysicsThread::addBody(btRigidBody* body, SceneNode* node, const btTransform& offset)
+{
+	post([this, body, node, offset](btDiscreteDynamicsWorld* world)
+	{
+		assert(!dynamic_cast<RigidBodyState*>(body->getMotionState()) && "The node of a PhysicsThread body is set by applySnapshot(), not by a RigidBodyState");
+		world->addRigidBody(body);
+		mEntries.push_back({ body, node, offset });
+	});
+}
+
+void PhysicsThread::removeBody(btRigidBody* body, std::function<void()> onRemoved)
+{
+	post([this, body, onRemoved](btDiscreteDynamicsWorld* world)
+	{
+		world->removeRigidBody(body);
+		mEntries.erase(std::remove_if(mEntries.begin(), mEntries.end(), [body](const Entry& entry) { return entry.body == body; }), mEntries.end());
+
+		//Only handed to the render thread once a snapshot without the body is published
+		if (onRemoved) mPendingCallbacks.push_back(onRemoved);
+	});
+}
+
+void PhysicsThread::applyImpulse(btRigidBody* body, const btVector3& impulse, const btVector3& relativePosition)
+{
+	post([body, impulse, relativePosition](btDiscreteDynamicsWorld*)
+	{
+		body->activate();
+		body->applyImpulse(impulse, relativePosition);
+	});
+}
+
+bool PhysicsThread::applySnapshot()
+{
+	const auto updated = mSnapshots.update();
+	if (updated)
+	{
+		const auto& snapshot = mSnapshots.getReadBuffer();
+		for (const auto& transform : snapshot.transforms)
+		{
+			transform.node->_setDerivedOrientation(transform.orientation);
+			transform.node->_setDerivedPosition(transform.position);
+		}
+		mSnapshotStep = snapshot.step;
+	}
+
+	//Pushed after the publication of a snapshot without their body, so the snapshots applied from now on can't refer to it
+	std::function<void()> callback;
+	while (mRemovedCallbacks.pop(callback))
+		callback();
+
+	return updated;
+}
+
+unsigned long long PhysicsThread::getSnapshotStep() const
+{
+	return mSnapshotStep;
+}
+
+double PhysicsThread::getLastStepTime() const
+{
+	return mLastStepTime;
+}
+
+void PhysicsThread::run()
+{
+	using clock = std::chrono::steady_clock;
+	const auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(mFixedTimeStep));
+	auto next = clock::now();
+
+	while (mRunning)
+	{
+		runCommands();
+
+		const auto start = clock::now();
+		mWorld->stepSimulation(mFixedTimeStep, 0);
+		++mStepCount;
+		mLastStepTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+		publishSnapshot();
+		for (auto& callback : mPendingCallbacks)
+			mRemovedCallbacks.push(std::move(callback));
+		mPendingCallbacks.clear();
+
+		//A step longer than the period delays the next ones instead of trying to catch up
+		next += period;
+		const auto now = clock::now();
+		if (next < now) next = now;
+		else std::this_thread::sleep_until(next);
+	}
+}
+
+void PhysicsThread::runCommands()
+{
+	Command command;
+	while (mCommands.pop(command))
+		command(mWorld);
+}
+
+void PhysicsThread::publishSnapshot()
+{
+	//Every body is written: the reader may skip snapshots, so they can't only hold the bodies that moved
+	auto& snapshot = mSnapshots.getWriteBuffer();
+	snapshot.step = mStepCount;
+	snapshot.transforms.resize(mEntries.size());
+	for (auto i = size_t{ 0U }; i < mEntries.size(); ++i)
+	{
+		const auto transform = mEntries[i].body->getWorldTransform() * mEntries[i].offset;
+		snapshot.transforms[i] = { mEntries[i].node, Convert::toOgre(transform.getOrigin()), Convert::toOgre(transform.getRotation()) };
+	}
+
+	mSnapshots.publish();
+}
+
+TaskPool::TaskPool(size_t threads) :
+	mTask(nullptr),
+	mRemaining(0),
+	mBatch(0),
+	mStop(false)
+{
+	for (auto i = size_t{ 0U }; i <= threads; ++i)
+		mQueues.emplace_back(new Queue);
+
+	for (auto i = size_t{ 0U }; i < threads; ++i)
+		mThreads.emplace_back(&TaskPool::work, this, i);
+}
+
+TaskPool::~TaskPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mStart.notify_all();
+
+	for (auto& thread : mThreads)
+		thread.join();
+}
+
+size_t TaskPool::getThreadCount() const
+{
+	return mQueues.size();
+}
+
+void TaskPool::run(size_t count, const std::function<void(size_t)>& task)
+{
+	if (!count) return;
+	std::lock_guard<std::mutex> runLock(mRunMutex);
+
+	mTask = &task;
+	mException = nullptr;
+	mRemaining = count;
+
+	//Deal the tasks round robin, the stealing evens out what's uneven
+	for (auto i = size_t{ 0U }; i < count; ++i)
+	{
+		auto& queue = *mQueues[i % mQueues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(i);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		++mBatch;
+	}
+	mStart.notify_all();
+
+	//The calling thread works too, then waits for the tasks still running elsewhere
+	while (runOne(mQueues.size() - 1)) {}
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [this] { return mRemaining == 0; });
+	lock.unlock();
+
+	mTask = nullptr;
+	if (mException) std::rethrow_exception(mException);
+}
+
+void TaskPool::work(size_t queue)
+{
+	auto batch = 0ULL;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mStart.wait(lock, [this, batch] { return mStop || mBatch != batch; });
+			if (mStop) return;
+			batch = mBatch;
+		}
+
+		while (runOne(queue));
+	}
+}
+
+bool TaskPool::runOne(size_t queue)
+{
+	auto found = false;
+	auto task = size_t{ 0U };
+
+	//Own queue from the back, the others from the front
+	for (auto i = size_t{ 0U }; i < mQueues.size() && !found; ++i)
+	{
+		const auto index = (queue + i) % mQueues.size();
+		auto& candidate = *mQueues[index];
+		std::lock_guard<std::mutex> lock(candidate.mutex);
+		if (candidate.tasks.empty()) continue;
+
+		if (index == queue)
+		{
+			task = candidate.tasks.back();
+			candidate.tasks.pop_back();
+		}
+		else
+		{
+			task = candidate.tasks.front();
+			candidate.tasks.pop_front();
+		}
+		found = true;
+	}
+
+	if (!found) return false;
+
+	try
+	{
+		(*mTask)(task);
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (!mException) mException = std::current_exception();
+	}
+
+	if (--mRemaining == 0)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mDone.notify_all();
+	}
+
+	return true;
+}
+
+WorldGroup::WorldGroup(TaskPool* pool) :
+	mPool(pool)
+{
+}
+
+void WorldGroup::addWorld(btDynamicsWorld* world, BodySyncSystem* sync)
+{
+	mMembers.push_back({ world, sync, 0 });
+}
+
+void WorldGroup::removeWorld(btDynamicsWorld* world)
+{
+	mMembers.erase(std::remove_if(mMembers.begin(), mMembers.end(), [world](const Member& member) { return member.world == world; }), mMembers.end());
+}
+
+size_t WorldGroup::getWorldCount() const
+{
+	return mMembers.size();
+}
+
+void WorldGroup::step(btScalar timeStep, int maxSubSteps, btScalar fixedTimeStep)
+{
+	mPool->run(mMembers.size(), [this, timeStep, maxSubSteps, fixedTimeStep](size_t index)
+	{
+		using clock = std::chrono::steady_clock;
+		const auto start = clock::now();
+
+		auto& member = mMembers[index];
+		member.world->stepSimulation(timeStep, maxSubSteps, fixedTimeStep);
+		if (member.sync) member.sync->synchronize();
+
+		member.lastStepTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	});
+}
+
+double WorldGroup::getLastStepTime(btDynamicsWorld* world) const
+{
+	for (const auto& member : mMembers)
+		if (member.world == world) return member.lastStepTime;
+
+	throw std::runtime_error("WorldGroup::getLastStepTime : world not in the group");
+}
+
+#if BT_THREADSAFE
+OgreTaskScheduler::OgreTaskScheduler(SceneManager* sceneManager) :
+	btITaskScheduler("OgreTaskScheduler"),
+	mSceneManager(sceneManager),
+	mNumThreads(int(sceneManager->getNumWorkerThreads()) + 1),
+	mRunning(false),
+	mNext(0),
+	mEnd(0),
+	mGrainSize(1),
+	mForBody(nullptr),
+#if BT_BULLET_VERSION >= 288
+	mSumBody(nullptr),
+#endif
+	mSums(sceneManager->getNumWorkerThreads() + 1, 0)
+{
+}
+
+int OgreTaskScheduler::getMaxNumThreads() const
+{
+	//Bullet gives index 0 to the calling thread, the per thread data it sizes with this count need one more slot than the workers
+	return int(mSceneManager->getNumWorkerThreads()) + 1;
+}
+
+int OgreTaskScheduler::getNumThreads() const
+{
+	return mNumThreads;
+}
+
+void OgreTaskScheduler::setNumThreads(int numThreads)
+{
+	mNumThreads = std::max(1, std::min(numThreads, getMaxNumThreads()));
+}
+
+void OgreTaskScheduler::parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+{
+	if (iBegin >= iEnd) return;
+
+	//Nested loop: the workers are busy with the outer one
+	auto running = false;
+	if (!mRunning.compare_exchange_strong(running, true))
+	{
+		body.forLoop(iBegin, iEnd);
+		return;
+	}
+
+	mForBody = &body;
+	run(iBegin, iEnd, grainSize);
+	mForBody = nullptr;
+	mRunning = false;
+}
+
+#if BT_BULLET_VERSION >= 288
+btScalar OgreTaskScheduler::parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body)
+{
+	if (iBegin >= iEnd) return 0;
+
+	auto running = false;
+	if (!mRunning.compare_exchange_strong(running, true))
+		return body.sumLoop(iBegin, iEnd);
+
+	std::fill(mSums.begin(), mSums.end(), btScalar(0));
+	mSumBody = &body;
+	run(iBegin, iEnd, grainSize);
+	mSumBody = nullptr;
+	mRunning = false;
+
+	auto sum = btScalar(0);
+	for (auto partial : mSums) sum += partial;
+	return sum;
+}
+#endif
+
+void OgreTaskScheduler::run(int iBegin, int iEnd, int grainSize)
+{
+	mNext = iBegin;
+	mEnd = iEnd;
+	mGrainSize = std::max(1, grainSize);
+
+	//No worker allowed, the calling thread does it all with the slot no worker uses
+	if (mNumThreads <= 1)
+	{
+		runChunks(mSums.size() - 1);
+		return;
+	}
+
+	//Blocks until every worker is done
+	mSceneManager->executeUserScalableTask(this, true);
+}
+
+void OgreTaskScheduler::execute(size_t threadId, size_t)
+{
+	//mNumThreads counts the calling thread, that waits for the workers
+	if (int(threadId) + 1 >= mNumThreads) return;
+
+	runChunks(threadId);
+}
+
+void OgreTaskScheduler::runChunks(size_t slot)
+{
+	for (;;)
+	{
+		const auto begin = mNext.fetch_add(mGrainSize);
+		if (begin >= mEnd) return;
+		const auto end = std::min(begin + mGrainSize, mEnd);
+
+#if BT_BULLET_VERSION >= 288
+		if (mSumBody)
+		{
+			mSums[slot] += mSumBody->sumLoop(begin, end);
+			continue;
+		}
+#endif
+		mForBody->forLoop(begin, end);
+	}
+}
+#endif
@@ -0,0 +1,323 @@
+/*
+ * =============================================================================================
+ *
+ *       Filename:  BtOgreWorld.cpp
+ *
+ *    Description:  BtOgre world helpers implementation.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =============================================================================================
+ */
+
+#include "BtOgreWorld.h"
+#include "BtOgrePG.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if BT_THREADSAFE
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#if BT_BULLET_VERSION >= 288
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#endif
+#endif
+
+#include <OgreLogManager.h>
+
+using namespace Ogre;
+using namespace BtOgre;
+
+namespace
+{
+	inline void log(const std::string& message)
+	{
+		LogManager::getSingleton().logMessage("BtOgreLog : " + message);
+	}
+
+	///Merge the bounds of the objects attached to a node and its children
+	void mergeNodeBounds(Node* node, Aabb& bounds)
+	{
+		if (auto sceneNode = dynamic_cast<SceneNode*>(node))
+		{
+			auto objects = sceneNode->getAttachedObjectIterator();
+			while (objects.hasMoreElements())
+			{
+				const auto aabb = objects.getNext()->getWorldAabbUpdated();
+				if (aabb.isFinite()) bounds.merge(aabb);
+			}
+		}
+
+		auto children = node->getChildIterator();
+		while (children.hasMoreElements())
+			mergeNodeBounds(children.getNext(), bounds);
+	}
+}
+
+PhysicsWorld::PhysicsWorld(const btVector3& gravity, SceneManager* workers) :
+	mCollisionConfig(nullptr),
+	mBroadphase(new btDbvtBroadphase),
+	mDispatcher(nullptr),
+	mSolver(nullptr),
+	mWorld(nullptr),
+	mSolverMt(nullptr),
+	mTaskScheduler(nullptr),
+	mInterpolator(nullptr)
+{
+	createWorld(gravity, workers);
+}
+
+PhysicsWorld::PhysicsWorld(const AxisAlignedBox& bounds, unsigned int maxObjects, const btVector3& gravity, SceneManager* workers) :
+	mCollisionConfig(nullptr),
+	mBroadphase(nullptr),
+	mDispatcher(nullptr),
+	mSolver(nullptr),
+	mWorld(nullptr),
+	mSolverMt(nullptr),
+	mTaskScheduler(nullptr),
+	mInterpolator(nullptr)
+{
+	if (!bounds.isFinite()) throw std::runtime_error("PhysicsWorld : the world bounds have to be finite");
+
+	const auto min = Convert::toBullet(bounds.getMinimum());
+	const auto max = Convert::toBullet(bounds.getMaximum());
+
+	//The 16 bit version stores its handles in unsigned shorts, and keeps one for itself
+	if (maxObjects <= 32766)
+		mBroadphase = new btAxisSweep3(min, max, static_cast<unsigned short>(maxObjects));
+	else
+		mBroadphase = new bt32BitAxisSweep3(min, max, maxObjects);
+
+	createWorld(gravity, workers);
+}
+
+PhysicsWorld::~PhysicsWorld()
+{
+	delete mInterpolator;
+	delete mWorld;
+	delete mSolver;
+	delete mSolverMt;
+	delete mDispatcher;
+	delete mCollisionConfig;
+	delete mBroadphase;
+
+#if BT_THREADSAFE
+	if (mTaskScheduler)
+	{
+		if (btGetTaskScheduler() == mTaskScheduler)
+			btSetTaskScheduler(btGetSequentialTaskScheduler());
+		delete mTaskScheduler;
+	}
+#endif
+}
+
+void PhysicsWorld::createWorld(const btVector3& gravity, SceneManager* workers)
+{
+	mCollisionConfig = new btDefaultCollisionConfiguration;
+
+#if BT_THREADSAFE
+	if (workers && workers->getNumWorkerThreads() > 1)
+	{
+		//Bullet's parallel loops run on Ogre's threads, no second pool competes for the cores
+		mTaskScheduler = new OgreTaskScheduler(workers);
+		btSetTaskScheduler(mTaskScheduler);
+
+		const auto threads = mTaskScheduler->getNumThreads();
+		mDispatcher = new btCollisionDispatcherMt(mCollisionConfig);
+		auto solverPool = new btConstraintSolverPoolMt(threads);
+		mSolver = solverPool;
+#if BT_BULLET_VERSION >= 288
+		mSolverMt = new btSequentialImpulseConstraintSolverMt;
+		mWorld = new btDiscreteDynamicsWorldMt(mDispatcher, mBroadphase, solverPool, mSolverMt, mCollisionConfig);
+#else
+		mWorld = new btDiscreteDynamicsWorldMt(mDispatcher, mBroadphase, solverPool, mCollisionConfig);
+#endif
+		mWorld->setGravity(gravity);
+		mInterpolator = new FixedStepInterpolator(mWorld, btScalar(1) / 60, 4);
+		return;
+	}
+#else
+	if (workers) log("PhysicsWorld : Bullet isn't built with BT_THREADSAFE, the world runs on the calling thread only");
+#endif
+
+	mDispatcher = new btCollisionDispatcher(mCollisionConfig);
+	mSolver = new btSequentialImpulseConstraintSolver;
+	mWorld = new btDiscreteDynamicsWorld(mDispatcher, mBroadphase, mSolver, mCollisionConfig);
+	mWorld->setGravity(gravity);
+	mInterpolator = new FixedStepInterpolator(mWorld, btScalar(1) / 60, 4);
+}
+
+AxisAlignedBox PhysicsWorld::getSceneBounds(SceneManager* sceneManager, Real margin)
+{
+	auto bounds = Aabb::BOX_NULL;
+	mergeNodeBounds(sceneManager->getRootSceneNode(SCENE_DYNAMIC), bounds);
+	mergeNodeBounds(sceneManager->getRootSceneNode(SCENE_STATIC), bounds);
+
+	if (bounds.mHalfSize == Aabb::BOX_NULL.mHalfSize) return AxisAlignedBox(AxisAlignedBox::BOX_NULL);
+
+	const Vector3 grow{ margin, margin, margin };
+	return { bounds.getMinimum() - grow, bounds.getMaximum() + grow };
+}
+
+int PhysicsWorld::step(btScalar frameTime)
+{
+	return mInterpolator->update(frameTime);
+}
+
+FixedStepInterpolator* PhysicsWorld::getInterpolator() const
+{
+	return mInterpolator;
+}
+
+void PhysicsWorld::setFixedTimeStep(btScalar fixedTimeStep)
+{
+	mInterpolator->setFixedTimeStep(fixedTimeStep);
+}
+
+btScalar PhysicsWorld::getFixedTimeStep() const
+{
+	return mInterpolator->getFixedTimeStep();
+}
+
+void PhysicsWorld::setMaxSubSteps(int maxSubSteps)
+{
+	mInterpolator->setMaxSubSteps(maxSubSteps);
+}
+
+int PhysicsWorld::getMaxSubSteps() const
+{
+	return mInterpolator->getMaxSubSteps();
+}
+
+btScalar PhysicsWorld::getAlpha() const
+{
+	return mInterpolator->getAlpha();
+}
+
+double PhysicsWorld::getLastStepTime() const
+{
+	return mInterpolator->getLastStepTime();
+}
+
+double PhysicsWorld::getLastUpdateTime() const
+{
+	return mInterpolator->getLastUpdateTime();
+}
+
+unsigned long long PhysicsWorld::getStepCount() const
+{
+	return mInterpolator->getStepCount();
+}
+
+btDiscreteDynamicsWorld* PhysicsWorld::getWorld() const
+{
+	return mWorld;
+}
+
+btBroadphaseInterface* PhysicsWorld::getBroadphase() const
+{
+	return mBroadphase;
+}
+
+btCollisionDispatcher* PhysicsWorld::getDispatcher() const
+{
+	return mDispatcher;
+}
+
+btConstraintSolver* PhysicsWorld::getSolver() const
+{
+	return mSolver;
+}
+
+bool PhysicsWorld::isMultithreaded() const
+{
+	return mTaskScheduler != nullptr;
+}
+
+FloatingOrigin::FloatingOrigin(btDynamicsWorld* world, SceneManager* sceneManager) :
+	mWorld(world),
+	mSceneManager(sceneManager),
+	mOrigin{ 0, 0, 0 }
+{
+	const auto broadphase = world->getBroadphase();
+	if (dynamic_cast<btAxisSweep3*>(broadphase) || dynamic_cast<bt32BitAxisSweep3*>(broadphase))
+		throw std::runtime_error("FloatingOrigin : the bounds of a sweep and prune broadphase can't follow the origin, use a btDbvtBroadphase");
+}
+
+void FloatingOrigin::addSyncSystem(BodySyncSystem* syncSystem)
+{
+	mSyncSystems.push_back(syncSystem);
+}
+
+void FloatingOrigin::removeSyncSystem(BodySyncSystem* syncSystem)
+{
+	mSyncSystems.erase(std::remove(mSyncSystems.begin(), mSyncSystems.end(), syncSystem), mSyncSystems.end());
+}
+
+void FloatingOrigin::shift(const btVector3& offset)
+{
+	//Permanent: the children of the root nodes are translated, the roots stay at the origin
+	mSceneManager->_setRelativeOrigin(Convert::toOgre(-offset), true);
+
+	auto& objects = mWorld->getCollisionObjectArray();
+	for (auto i = 0; i < objects.size(); ++i)
+	{
+		auto object = objects[i];
+		object->getWorldTransform().getOrigin() -= offset;
+
+		if (auto body = btRigidBody::upcast(object))
+		{
+			auto interpolation = body->getInterpolationWorldTransform();
+			interpolation.getOrigin() -= offset;
+			body->setInterpolationWorldTransform(interpolation);
+
+			//The nodes have already been moved with the scene, only the stored transforms are rebased
+			const auto motionState = body->getMotionState();
+			if (auto rigidBodyState = dynamic_cast<RigidBodyState*>(motionState))
+				rigidBodyState->shiftOrigin(offset);
+			else if (auto kinematicState = dynamic_cast<KinematicMotionState*>(motionState))
+				kinematicState->shiftOrigin(offset);
+		}
+
+		//Move the broadphase proxy, sleeping objects included
+		mWorld->updateSingleAabb(object);
+	}
+
+	for (auto syncSystem : mSyncSystems)
+		syncSystem->shiftOrigin(offset);
+
+	mOrigin[0] += offset.x();
+	mOrigin[1] += offset.y();
+	mOrigin[2] += offset.z();
+}
+
+bool FloatingOrigin::recenter(const Vector3& position, Real threshold)
+{
+	if (position.squaredLength() <= threshold * threshold) return false;
+
+	shift(Convert::toBullet(position));
+	return true;
+}
+
+void FloatingOrigin::getOrigin(double& x, double& y, double& z) const
+{
+	x = mOrigin[0];
+	y = mOrigin[1];
+	z = mOrigin[2];
+}
+
+void FloatingOrigin::toWorld(const Vector3& local, double& x, double& y, double& z) const
+{
+	x = mOrigin[0] + local.x;
+	y = mOrigin[1] + local.y;
+	z = mOrigin[2] + local.z;
+}
+
+Vector3 FloatingOrigin::toLocal(double x, double y, double z) const
+{
+	return { Real(x - mOrigin[0]), Real(y - mOrigin[1]), Real(z - mOrigin[2]) };
+}
@@ -0,0 +1,221 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  BtOgreCook.cpp
+ *
+ *    Description:  Offline collision cooking tool. Read .mesh files, build the Bullet
+ *                  shapes (BVH included) and write them serialized to disk.
+ *
+ *        Version:  1.0
+ *        Created:  18/10/2026
+ *
+ *         Author:  Arthur Brainville (Ybalrid)
+ *
+ * =====================================================================================
+ */
+
+//C++ standard library
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Ogre includes
+#include <OgreFileSystemLayer.h>
+#include <OgreLogManager.h>
+
+//BtOgre includes
+#include <BtOgre.hpp>
+#include <BtOgreGP.h>
+
+namespace
+{
+	///A mesh file to cook, and how
+	struct CookJob
+	{
+		std::string meshFile;
+		std::string recipe;
+		bool morton;
+	};
+
+	void usage()
+	{
+		std::cout << "Usage: BtOgreCook [options] file.mesh [file.mesh...]\n"
+			<< "Options (apply to the files that follow them):\n"
+			<< "  -o <directory>   Output directory, created if missing (default: current directory)\n"
+			<< "  -s <recipe>      Shape to build: trimesh (default), convex, box, sphere, cylinder, capsule, compound\n"
+			<< "  -m               Sort trimesh triangles in Morton order\n"
+			<< "  -j <threads>     Number of files processed in parallel (default: number of cores)\n"
+			<< "Each file is written as <directory>/<mesh name>.<recipe>.bullet, loadable with btBulletWorldImporter\n";
+	}
+
+	///Build the shape a recipe asks for. Return nullptr on unknown recipes
+	btCollisionShape* createShape(BtOgre::StaticMeshToShapeConverter& converter, const std::string& recipe)
+	{
+		if (recipe == "trimesh") return converter.createTrimesh();
+		if (recipe == "convex") return converter.createConvex();
+		if (recipe == "box") return converter.createBox();
+		if (recipe == "sphere") return converter.createSphere();
+		if (recipe == "cylinder") return converter.createCylinder();
+		if (recipe == "capsule") return converter.createCapsule();
+		if (recipe == "compound") return converter.createPrimitiveCompound();
+		return nullptr;
+	}
+
+	///Free a shape and what it owns
+	void destroyShape(btCollisionShape* shape)
+	{
+		if (shape->isCompound())
+		{
+			const auto compound = static_cast<btCompoundShape*>(shape);
+			for (auto i = compound->getNumChildShapes() - 1; i >= 0; --i)
+			{
+				const auto child = compound->getChildShape(i);
+				compound->removeChildShapeByIndex(i);
+				destroyShape(child);
+			}
+		}
+		else if (shape->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE)
+		{
+			//Here's a quirk of the cleanup of a "triangle" based collision shape: You need to delete the mesh interface
+			delete static_cast<btTriangleMeshShape*>(shape)->getMeshInterface();
+		}
+		delete shape;
+	}
+
+	///Name of the file without the directories and the extension
+	std::string baseName(const std::string& path)
+	{
+		const auto slash = path.find_last_of("/\\");
+		auto name = slash == std::string::npos ? path : path.substr(slash + 1);
+		const auto dot = name.find_last_of('.');
+		return dot == std::string::npos ? name : name.substr(0, dot);
+	}
+
+	///Create a directory and its missing parents. Return false if it still doesn't exist
+	bool createDirectories(const std::string& path)
+	{
+		//Each parent is created in turn, createDirectory only makes the last level
+		for (auto separator = path.find_first_of("/\\", 1); separator != std::string::npos; separator = path.find_first_of("/\\", separator + 1))
+			Ogre::FileSystemLayer::createDirectory(path.substr(0, separator));
+		Ogre::FileSystemLayer::createDirectory(path);
+
+		return Ogre::FileSystemLayer::fileExists(path);
+	}
+
+	///Cook one file. Throw on error
+	void cook(const CookJob& job, const std::string& outputDirectory)
+	{
+		BtOgre::MeshFileReader meshFile(job.meshFile);
+		BtOgre::StaticMeshToShapeConverter converter(meshFile);
+		converter.setMortonOrdering(job.morton);
+
+		const auto shape = createShape(converter, job.recipe);
+		if (!shape) throw std::runtime_error("unknown recipe " + job.recipe);
+
+		btDefaultSerializer serializer;
+		serializer.startSerialization();
+		shape->serializeSingleShape(&serializer);
+		serializer.finishSerialization();
+
+		const auto outputFile = outputDirectory + "/" + baseName(job.meshFile) + "." + job.recipe + ".bullet";
+		std::ofstream output(outputFile, std::ios::binary);
+		output.write(reinterpret_cast<const char*>(serializer.getBufferPointer()), serializer.getCurrentBufferSize());
+		destroyShape(shape);
+
+		if (!output) throw std::runtime_error("cannot write " + outputFile);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<CookJob> jobs;
+	std::string outputDirectory{ "." };
+	std::string recipe{ "trimesh" };
+	auto morton = false;
+	auto threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	for (auto i = 1; i < argc; ++i)
+	{
+		const std::string arg{ argv[i] };
+		const auto hasValue = i + 1 < argc;
+
+		if (arg == "-o" && hasValue) outputDirectory = argv[++i];
+		else if (arg == "-s" && hasValue) recipe = argv[++i];
+		else if (arg == "-m") morton = true;
+		else if (arg == "-j" && hasValue)
+		{
+			try
+			{
+				threadCount = std::max(1, std::stoi(argv[++i]));
+			}
+			catch (const std::exception&)
+			{
+				std::cerr << "invalid thread count " << argv[i] << "\n";
+				usage();
+				return 1;
+			}
+		}
+		else if (arg == "-h" || arg == "--help")
+		{
+			usage();
+			return 0;
+		}
+		else if (arg[0] == '-')
+		{
+			usage();
+			return 1;
+		}
+		else jobs.push_back({ arg, recipe, morton });
+	}
+
+	if (jobs.empty())
+	{
+		usage();
+		return 1;
+	}
+
+	if (!createDirectories(outputDirectory))
+	{
+		std::cerr << "cannot create the output directory " << outputDirectory << "\n";
+		return 1;
+	}
+
+	//The converters log through Ogre, there's no Root here to create the log manager
+	Ogre::LogManager logManager;
+	logManager.createLog("BtOgreCook.log", true, false, true);
+
+	std::atomic<size_t> nextJob{ 0 };
+	std::atomic<int> failures{ 0 };
+	std::mutex outputMutex;
+
+	const auto worker = [&]
+	{
+		for (auto job = nextJob++; job < jobs.size(); job = nextJob++)
+		{
+			try
+			{
+				cook(jobs[job], outputDirectory);
+				std::lock_guard<std::mutex> lock(outputMutex);
+				std::cout << "cooked " << jobs[job].meshFile << " (" << jobs[job].recipe << ")\n";
+			}
+			catch (const std::exception& e)
+			{
+				++failures;
+				std::lock_guard<std::mutex> lock(outputMutex);
+				std::cerr << "failed " << jobs[job].meshFile << " : " << e.what() << "\n";
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (auto i = 1u; i < std::min<size_t>(threadCount, jobs.size()); ++i)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& thread : threads)
+		thread.join();
+
+	return failures ? 1 : 0;
+}